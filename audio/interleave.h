@@ -0,0 +1,355 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+// Define AUDIO_SCALAR_KERNELS to force the portable kernels on any target
+#if !defined(AUDIO_SCALAR_KERNELS) && defined(__SSE2__)
+#define AUDIO_KERNELS_SSE
+#include <emmintrin.h>
+#elif !defined(AUDIO_SCALAR_KERNELS) && defined(__ARM_NEON)
+#define AUDIO_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace Audio
+{
+    // Shuffles between interleaved frames, as the DMA and WAV files carry them,
+    // and one buffer per channel. Samples are any 32 bit type and are moved
+    // bit for bit. 2, 4 and 8 channels run four frames per vector step, other
+    // counts and the remaining frames take the scalar loop.
+    namespace kernels
+    {
+        template <typename T>
+        inline void deinterleaveScalar(const T *frames, std::size_t count, std::size_t channels, T *const *out, std::size_t from)
+        {
+            for (std::size_t frame = from; frame < count; frame++)
+                for (std::size_t ch = 0; ch < channels; ch++)
+                    out[ch][frame] = frames[frame * channels + ch];
+        }
+
+        template <typename T>
+        inline void interleaveScalar(const T *const *in, std::size_t channels, std::size_t count, T *frames, std::size_t from)
+        {
+            for (std::size_t frame = from; frame < count; frame++)
+                for (std::size_t ch = 0; ch < channels; ch++)
+                    frames[frame * channels + ch] = in[ch][frame];
+        }
+
+#if defined(AUDIO_KERNELS_SSE)
+        // 4x4 transpose of 32 bit lanes, its own inverse
+        inline void transpose4(__m128i &a, __m128i &b, __m128i &c, __m128i &d)
+        {
+            __m128i ab0 = _mm_unpacklo_epi32(a, b);
+            __m128i cd0 = _mm_unpacklo_epi32(c, d);
+            __m128i ab1 = _mm_unpackhi_epi32(a, b);
+            __m128i cd1 = _mm_unpackhi_epi32(c, d);
+            a = _mm_unpacklo_epi64(ab0, cd0);
+            b = _mm_unpackhi_epi64(ab0, cd0);
+            c = _mm_unpacklo_epi64(ab1, cd1);
+            d = _mm_unpackhi_epi64(ab1, cd1);
+        }
+
+        inline __m128i load(const void *p)
+        {
+            return _mm_loadu_si128(static_cast<const __m128i *>(p));
+        }
+
+        inline void store(void *p, __m128i v)
+        {
+            _mm_storeu_si128(static_cast<__m128i *>(p), v);
+        }
+
+        // Frames handled by the vector loop, the rest are left to the scalar one
+        template <std::size_t Channels, typename T>
+        inline std::size_t deinterleaveVector(const T *frames, std::size_t count, T *const *out)
+        {
+            std::size_t blocked = count - count % 4;
+            for (std::size_t f = 0; f < blocked; f += 4)
+            {
+                const T *in = frames + f * Channels;
+                if constexpr (Channels == 2)
+                {
+                    // c0 c1 c0 c1 -> c0 c0 c1 c1 per vector, then split the halves
+                    __m128i a = _mm_shuffle_epi32(load(in), _MM_SHUFFLE(3, 1, 2, 0));
+                    __m128i b = _mm_shuffle_epi32(load(in + 4), _MM_SHUFFLE(3, 1, 2, 0));
+                    store(out[0] + f, _mm_unpacklo_epi64(a, b));
+                    store(out[1] + f, _mm_unpackhi_epi64(a, b));
+                }
+                else
+                {
+                    for (std::size_t half = 0; half < Channels / 4; half++)
+                    {
+                        __m128i a = load(in + half * 4);
+                        __m128i b = load(in + Channels + half * 4);
+                        __m128i c = load(in + 2 * Channels + half * 4);
+                        __m128i d = load(in + 3 * Channels + half * 4);
+                        transpose4(a, b, c, d);
+                        store(out[half * 4] + f, a);
+                        store(out[half * 4 + 1] + f, b);
+                        store(out[half * 4 + 2] + f, c);
+                        store(out[half * 4 + 3] + f, d);
+                    }
+                }
+            }
+            return blocked;
+        }
+
+        template <std::size_t Channels, typename T>
+        inline std::size_t interleaveVector(const T *const *in, std::size_t count, T *frames)
+        {
+            std::size_t blocked = count - count % 4;
+            for (std::size_t f = 0; f < blocked; f += 4)
+            {
+                T *out = frames + f * Channels;
+                if constexpr (Channels == 2)
+                {
+                    __m128i a = load(in[0] + f);
+                    __m128i b = load(in[1] + f);
+                    store(out, _mm_unpacklo_epi32(a, b));
+                    store(out + 4, _mm_unpackhi_epi32(a, b));
+                }
+                else
+                {
+                    for (std::size_t half = 0; half < Channels / 4; half++)
+                    {
+                        __m128i a = load(in[half * 4] + f);
+                        __m128i b = load(in[half * 4 + 1] + f);
+                        __m128i c = load(in[half * 4 + 2] + f);
+                        __m128i d = load(in[half * 4 + 3] + f);
+                        transpose4(a, b, c, d);
+                        store(out + half * 4, a);
+                        store(out + Channels + half * 4, b);
+                        store(out + 2 * Channels + half * 4, c);
+                        store(out + 3 * Channels + half * 4, d);
+                    }
+                }
+            }
+            return blocked;
+        }
+#elif defined(AUDIO_KERNELS_NEON)
+        inline int32x4_t load(const void *p)
+        {
+            return vld1q_s32(static_cast<const int32_t *>(p));
+        }
+
+        inline void store(void *p, int32x4_t v)
+        {
+            vst1q_s32(static_cast<int32_t *>(p), v);
+        }
+
+        template <std::size_t Channels, typename T>
+        inline std::size_t deinterleaveVector(const T *frames, std::size_t count, T *const *out)
+        {
+            std::size_t blocked = count - count % 4;
+            for (std::size_t f = 0; f < blocked; f += 4)
+            {
+                const auto *in = reinterpret_cast<const int32_t *>(frames + f * Channels);
+                if constexpr (Channels == 2)
+                {
+                    int32x4x2_t v = vld2q_s32(in);
+                    store(out[0] + f, v.val[0]);
+                    store(out[1] + f, v.val[1]);
+                }
+                else if constexpr (Channels == 4)
+                {
+                    int32x4x4_t v = vld4q_s32(in);
+                    for (std::size_t ch = 0; ch < 4; ch++)
+                        store(out[ch] + f, v.val[ch]);
+                }
+                else
+                {
+                    // Stride 4 loads pair channel ch with ch + 4, two frames each
+                    int32x4x4_t lo = vld4q_s32(in);
+                    int32x4x4_t hi = vld4q_s32(in + 16);
+                    for (std::size_t ch = 0; ch < 4; ch++)
+                    {
+                        int32x4x2_t split = vuzpq_s32(lo.val[ch], hi.val[ch]);
+                        store(out[ch] + f, split.val[0]);
+                        store(out[ch + 4] + f, split.val[1]);
+                    }
+                }
+            }
+            return blocked;
+        }
+
+        template <std::size_t Channels, typename T>
+        inline std::size_t interleaveVector(const T *const *in, std::size_t count, T *frames)
+        {
+            std::size_t blocked = count - count % 4;
+            for (std::size_t f = 0; f < blocked; f += 4)
+            {
+                auto *out = reinterpret_cast<int32_t *>(frames + f * Channels);
+                if constexpr (Channels == 2)
+                {
+                    int32x4x2_t v = {{load(in[0] + f), load(in[1] + f)}};
+                    vst2q_s32(out, v);
+                }
+                else if constexpr (Channels == 4)
+                {
+                    int32x4x4_t v = {{load(in[0] + f), load(in[1] + f), load(in[2] + f), load(in[3] + f)}};
+                    vst4q_s32(out, v);
+                }
+                else
+                {
+                    int32x4x4_t lo;
+                    int32x4x4_t hi;
+                    for (std::size_t ch = 0; ch < 4; ch++)
+                    {
+                        int32x4x2_t pair = vzipq_s32(load(in[ch] + f), load(in[ch + 4] + f));
+                        lo.val[ch] = pair.val[0];
+                        hi.val[ch] = pair.val[1];
+                    }
+                    vst4q_s32(out, lo);
+                    vst4q_s32(out + 16, hi);
+                }
+            }
+            return blocked;
+        }
+#else
+        template <std::size_t Channels, typename T>
+        inline std::size_t deinterleaveVector(const T *, std::size_t, T *const *)
+        {
+            return 0;
+        }
+
+        template <std::size_t Channels, typename T>
+        inline std::size_t interleaveVector(const T *const *, std::size_t, T *)
+        {
+            return 0;
+        }
+#endif
+    }
+
+    constexpr std::size_t MAX_INTERLEAVED_CHANNELS = 32;
+
+    // Split frames into one span per channel, each at least frames / channels long
+    template <typename T>
+    void deinterleave(std::span<const T> frames, std::span<const std::span<T>> channels)
+    {
+        static_assert(sizeof(T) == 4 && std::is_trivially_copyable_v<T>, "Kernels move 32 bit samples");
+
+        std::size_t count = channels.empty() ? 0 : frames.size() / channels.size();
+        if (channels.empty() || channels.size() > MAX_INTERLEAVED_CHANNELS || frames.size() % channels.size() != 0)
+            throw std::invalid_argument("Deinterleave needs whole frames of at most 32 channels");
+
+        T *out[MAX_INTERLEAVED_CHANNELS];
+        for (std::size_t ch = 0; ch < channels.size(); ch++)
+        {
+            if (channels[ch].size() < count)
+                throw std::invalid_argument("Deinterleave channel buffer is too short");
+            out[ch] = channels[ch].data();
+        }
+
+        std::size_t done = 0;
+        switch (channels.size())
+        {
+        case 2:
+            done = kernels::deinterleaveVector<2>(frames.data(), count, out);
+            break;
+        case 4:
+            done = kernels::deinterleaveVector<4>(frames.data(), count, out);
+            break;
+        case 8:
+            done = kernels::deinterleaveVector<8>(frames.data(), count, out);
+            break;
+        default:
+            break;
+        }
+        kernels::deinterleaveScalar(frames.data(), count, channels.size(), out, done);
+    }
+
+    // Merge one span per channel into frames, each channel frames / channels long
+    template <typename T>
+    void interleave(std::span<const std::span<const T>> channels, std::span<T> frames)
+    {
+        static_assert(sizeof(T) == 4 && std::is_trivially_copyable_v<T>, "Kernels move 32 bit samples");
+
+        std::size_t count = channels.empty() ? 0 : frames.size() / channels.size();
+        if (channels.empty() || channels.size() > MAX_INTERLEAVED_CHANNELS || frames.size() % channels.size() != 0)
+            throw std::invalid_argument("Interleave needs whole frames of at most 32 channels");
+
+        const T *in[MAX_INTERLEAVED_CHANNELS];
+        for (std::size_t ch = 0; ch < channels.size(); ch++)
+        {
+            if (channels[ch].size() < count)
+                throw std::invalid_argument("Interleave channel buffer is too short");
+            in[ch] = channels[ch].data();
+        }
+
+        std::size_t done = 0;
+        switch (channels.size())
+        {
+        case 2:
+            done = kernels::interleaveVector<2>(in, count, frames.data());
+            break;
+        case 4:
+            done = kernels::interleaveVector<4>(in, count, frames.data());
+            break;
+        case 8:
+            done = kernels::interleaveVector<8>(in, count, frames.data());
+            break;
+        default:
+            break;
+        }
+        kernels::interleaveScalar(in, channels.size(), count, frames.data(), done);
+    }
+
+    // 24 bit samples carried in the low bits of 32 bit words, as the ADC
+    // delivers them, packed to and from 3 little endian bytes. Four samples
+    // move as three words rather than twelve single byte stores.
+    static_assert(std::endian::native == std::endian::little, "24 bit packing assumes a little endian host");
+
+    inline void pack24(std::span<const int32_t> samples, uint8_t *bytes)
+    {
+        std::size_t blocked = samples.size() - samples.size() % 4;
+        for (std::size_t idx = 0; idx < blocked; idx += 4)
+        {
+            auto a = static_cast<uint32_t>(samples[idx]);
+            auto b = static_cast<uint32_t>(samples[idx + 1]);
+            auto c = static_cast<uint32_t>(samples[idx + 2]);
+            auto d = static_cast<uint32_t>(samples[idx + 3]);
+            uint32_t words[3] = {(a & 0xFFFFFFU) | (b << 24), ((b >> 8) & 0xFFFFU) | (c << 16), ((c >> 16) & 0xFFU) | (d << 8)};
+            std::memcpy(bytes + 3 * idx, words, sizeof(words));
+        }
+        for (std::size_t idx = blocked; idx < samples.size(); idx++)
+        {
+            auto value = static_cast<uint32_t>(samples[idx]);
+            bytes[3 * idx] = static_cast<uint8_t>(value);
+            bytes[3 * idx + 1] = static_cast<uint8_t>(value >> 8);
+            bytes[3 * idx + 2] = static_cast<uint8_t>(value >> 16);
+        }
+    }
+
+    // Sign extends each sample from bit 23
+    inline void unpack24(const uint8_t *bytes, std::span<int32_t> samples)
+    {
+        auto extend = [](uint32_t value)
+        { return static_cast<int32_t>(value << 8) >> 8; };
+
+        std::size_t blocked = samples.size() - samples.size() % 4;
+        for (std::size_t idx = 0; idx < blocked; idx += 4)
+        {
+            uint32_t words[3];
+            std::memcpy(words, bytes + 3 * idx, sizeof(words));
+            samples[idx] = extend(words[0]);
+            samples[idx + 1] = extend((words[0] >> 24) | (words[1] << 8));
+            samples[idx + 2] = extend((words[1] >> 16) | (words[2] << 16));
+            samples[idx + 3] = extend(words[2] >> 8);
+        }
+        for (std::size_t idx = blocked; idx < samples.size(); idx++)
+            samples[idx] = extend(bytes[3 * idx] | (bytes[3 * idx + 1] << 8) | (static_cast<uint32_t>(bytes[3 * idx + 2]) << 16));
+    }
+
+    // Sign extends DMA words whose top byte is not a copy of bit 23
+    inline void signExtend24(std::span<int32_t> samples)
+    {
+        for (auto &sample : samples)
+            sample = static_cast<int32_t>(static_cast<uint32_t>(sample) << 8) >> 8;
+    }
+}
@@ -0,0 +1,107 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mappedWav.h"
+
+namespace Audio
+{
+    MappedWav::MappedWav(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Failed to open " + path + ": " + std::strerror(errno));
+
+        struct stat status;
+        if (::fstat(fd, &status) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Failed to stat " + path + ": " + std::strerror(errno));
+        }
+        mapBytes = static_cast<std::size_t>(status.st_size);
+
+        // The mapping holds its own reference to the file
+        map = mapBytes > 0 ? ::mmap(nullptr, mapBytes, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (map == MAP_FAILED)
+        {
+            map = nullptr;
+            throw std::runtime_error("Failed to map " + path);
+        }
+
+        const uint8_t *bytes = static_cast<const uint8_t *>(map);
+        const uint8_t *end = bytes + mapBytes;
+        try
+        {
+            if (mapBytes < 12 || (std::memcmp(bytes, "RIFF", 4) != 0 && std::memcmp(bytes, "RF64", 4) != 0) || std::memcmp(bytes + 8, "WAVE", 4) != 0)
+                throw std::runtime_error(path + " is not a RIFF WAVE file");
+
+            bool haveFormat = false;
+            uint64_t rf64DataSize = 0; // from ds64, for a data chunk sized -1
+            const uint8_t *chunk = bytes + 12;
+            while (payload == nullptr)
+            {
+                if (end - chunk < 8)
+                    throw std::runtime_error(path + " has no data chunk");
+
+                uint64_t chunkSize = readLE32(chunk + 4);
+                const uint8_t *body = chunk + 8;
+                uint64_t available = static_cast<uint64_t>(end - body);
+
+                if (std::memcmp(chunk, "fmt ", 4) == 0)
+                {
+                    if (chunkSize > available)
+                        throw std::runtime_error(path + " has a truncated fmt chunk");
+                    wavFormat = parseFormatChunk(body, chunkSize);
+                    haveFormat = true;
+                }
+                else if (std::memcmp(chunk, "ds64", 4) == 0)
+                {
+                    // RIFF size, then data size, both 64 bit
+                    if (chunkSize < 16 || chunkSize > available)
+                        throw std::runtime_error(path + " has a truncated ds64 chunk");
+                    rf64DataSize = readLE64(body + 8);
+                }
+                else if (std::memcmp(chunk, "data", 4) == 0)
+                {
+                    if (!haveFormat)
+                        throw std::runtime_error(path + " has no fmt chunk before its data");
+
+                    // RF64 sets the size to -1 and keeps the real one in ds64. An
+                    // unfinalised header leaves it empty, the data runs to the end
+                    if (chunkSize == UINT32_MAX && rf64DataSize > 0)
+                        chunkSize = rf64DataSize;
+                    if (chunkSize == 0 || chunkSize == UINT32_MAX || chunkSize > available)
+                        chunkSize = available;
+
+                    payload = body;
+                    totalFrames = chunkSize / wavFormat.bytesPerFrame();
+                }
+
+                // Chunks are word aligned
+                chunk = body + std::min(available, chunkSize + (chunkSize & 1U));
+            }
+        }
+        catch (...)
+        {
+            ::munmap(map, mapBytes);
+            throw;
+        }
+    }
+
+    MappedWav::~MappedWav()
+    {
+        if (map != nullptr)
+            ::munmap(map, mapBytes);
+    }
+
+    void MappedWav::adviseSequential() const
+    {
+        ::madvise(map, mapBytes, MADV_SEQUENTIAL);
+    }
+}
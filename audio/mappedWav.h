@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "wav.h"
+
+namespace Audio
+{
+    // One channel of interleaved WAV data, read in place. Each element is a
+    // sample Codec::bytes wide, stride bytes after the previous one, decoded to a
+    // float on access. Random access, so it slots into the filter block API and
+    // Correlation without first being copied out.
+    template <typename Codec>
+    class ChannelView : public std::ranges::view_interface<ChannelView<Codec>>
+    {
+        const uint8_t *first = nullptr;
+        std::size_t stride = 0;
+        std::size_t count = 0;
+
+    public:
+        class iterator
+        {
+            const uint8_t *sample = nullptr;
+            std::ptrdiff_t stride = 0;
+
+        public:
+            using iterator_concept = std::random_access_iterator_tag;
+            using iterator_category = std::input_iterator_tag;
+            using value_type = float;
+            using difference_type = std::ptrdiff_t;
+
+            iterator() = default;
+            iterator(const uint8_t *sample, std::size_t stride) : sample(sample), stride(static_cast<std::ptrdiff_t>(stride)) {};
+
+            float operator*() const
+            {
+                return Codec::decode(sample);
+            }
+
+            float operator[](difference_type offset) const
+            {
+                return Codec::decode(sample + offset * stride);
+            }
+
+            iterator &operator++()
+            {
+                sample += stride;
+                return *this;
+            }
+
+            iterator operator++(int)
+            {
+                iterator previous = *this;
+                sample += stride;
+                return previous;
+            }
+
+            iterator &operator--()
+            {
+                sample -= stride;
+                return *this;
+            }
+
+            iterator operator--(int)
+            {
+                iterator previous = *this;
+                sample -= stride;
+                return previous;
+            }
+
+            iterator &operator+=(difference_type offset)
+            {
+                sample += offset * stride;
+                return *this;
+            }
+
+            iterator &operator-=(difference_type offset)
+            {
+                sample -= offset * stride;
+                return *this;
+            }
+
+            friend iterator operator+(iterator it, difference_type offset)
+            {
+                return it += offset;
+            }
+
+            friend iterator operator+(difference_type offset, iterator it)
+            {
+                return it += offset;
+            }
+
+            friend iterator operator-(iterator it, difference_type offset)
+            {
+                return it -= offset;
+            }
+
+            friend difference_type operator-(const iterator &a, const iterator &b)
+            {
+                return (a.sample - b.sample) / a.stride;
+            }
+
+            friend bool operator==(const iterator &a, const iterator &b)
+            {
+                return a.sample == b.sample;
+            }
+
+            friend auto operator<=>(const iterator &a, const iterator &b)
+            {
+                return std::compare_three_way{}(a.sample, b.sample);
+            }
+        };
+
+        ChannelView() = default;
+        ChannelView(const uint8_t *first, std::size_t stride, std::size_t count) : first(first), stride(stride), count(count) {};
+
+        iterator begin() const
+        {
+            return iterator(first, stride);
+        }
+
+        iterator end() const
+        {
+            return iterator(first + count * stride, stride);
+        }
+
+        std::size_t size() const
+        {
+            return count;
+        }
+
+        float operator[](std::size_t idx) const
+        {
+            return Codec::decode(first + idx * stride);
+        }
+
+        // Samples [offset, offset + length), clipped to the view
+        ChannelView subview(std::size_t offset, std::size_t length) const
+        {
+            offset = std::min(offset, count);
+            return ChannelView(first + offset * stride, stride, std::min(length, count - offset));
+        }
+    };
+
+    // A WAV file mapped read only into memory. Opening only parses the header,
+    // samples are paged in by the kernel as the channel views touch them.
+    class MappedWav
+    {
+        void *map = nullptr;
+        std::size_t mapBytes = 0;
+        const uint8_t *payload = nullptr;
+        WavFormat wavFormat{};
+        uint64_t totalFrames = 0;
+
+    public:
+        explicit MappedWav(const std::string &path);
+        ~MappedWav();
+
+        MappedWav(const MappedWav &) = delete;
+        MappedWav &operator=(const MappedWav &) = delete;
+
+        const WavFormat &format() const
+        {
+            return wavFormat;
+        }
+
+        uint64_t frames() const
+        {
+            return totalFrames;
+        }
+
+        // The raw interleaved sample bytes
+        std::span<const uint8_t> data() const
+        {
+            return {payload, static_cast<std::size_t>(totalFrames * wavFormat.bytesPerFrame())};
+        }
+
+        // Typed view of one channel, Codec must match the file's format
+        template <typename Codec>
+        ChannelView<Codec> channel(std::size_t index) const
+        {
+            if (index >= wavFormat.channels)
+                throw std::out_of_range("WAV channel out of range");
+            if (!visitCodec(wavFormat, [](auto codec)
+                            { return std::is_same_v<decltype(codec), Codec>; }))
+                throw std::invalid_argument("WAV codec does not match the file format");
+
+            return ChannelView<Codec>(payload + index * Codec::bytes, wavFormat.bytesPerFrame(), static_cast<std::size_t>(totalFrames));
+        }
+
+        // Call f with the typed view of channel index that matches the file's format
+        template <typename F>
+        decltype(auto) visitChannel(std::size_t index, F &&f) const
+        {
+            return visitCodec(wavFormat, [&](auto codec) -> decltype(auto)
+                              { return f(channel<decltype(codec)>(index)); });
+        }
+
+        // Hint that the channel views will be walked front to back
+        void adviseSequential() const;
+    };
+}
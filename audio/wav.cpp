@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "interleave.h"
+#include "wav.h"
+
+namespace Audio
+{
+    void writeLE16(uint8_t *bytes, uint16_t value)
+    {
+        bytes[0] = static_cast<uint8_t>(value);
+        bytes[1] = static_cast<uint8_t>(value >> 8);
+    }
+
+    void writeLE32(uint8_t *bytes, uint32_t value)
+    {
+        for (std::size_t idx = 0; idx < 4; idx++)
+            bytes[idx] = static_cast<uint8_t>(value >> (8 * idx));
+    }
+
+    void writeLE64(uint8_t *bytes, uint64_t value)
+    {
+        for (std::size_t idx = 0; idx < 8; idx++)
+            bytes[idx] = static_cast<uint8_t>(value >> (8 * idx));
+    }
+
+    WavFormat parseFormatChunk(const uint8_t *fmt, std::size_t size)
+    {
+        constexpr uint16_t WAVE_FORMAT_PCM = 0x0001;
+        constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+        constexpr uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+        if (size < 16)
+            throw std::runtime_error("Truncated WAV fmt chunk");
+
+        uint16_t formatTag = readLE16(fmt);
+        if (formatTag == WAVE_FORMAT_EXTENSIBLE && size >= 26)
+            formatTag = readLE16(fmt + 24); // First two bytes of the sub format GUID
+
+        WavFormat format{};
+        format.channels = readLE16(fmt + 2);
+        format.sampleRate = readLE32(fmt + 4);
+        format.bitDepth = readLE16(fmt + 14);
+
+        if (formatTag == WAVE_FORMAT_PCM)
+            format.encoding = SampleEncoding::PCM;
+        else if (formatTag == WAVE_FORMAT_IEEE_FLOAT)
+            format.encoding = SampleEncoding::FLOAT;
+        else
+            throw std::runtime_error("Unsupported WAV sample format");
+
+        if (format.channels == 0)
+            throw std::runtime_error("WAV file has no channels");
+
+        // Throws for a bit depth without a codec
+        visitCodec(format, [](auto) {});
+        return format;
+    }
+
+    void decodeSamples(const WavFormat &format, const uint8_t *bytes, std::span<float> samples)
+    {
+        visitCodec(format, [&](auto codec)
+                   {
+                       using Codec = decltype(codec);
+                       for (std::size_t idx = 0; idx < samples.size(); idx++)
+                           samples[idx] = Codec::decode(bytes + Codec::bytes * idx); });
+    }
+
+    void encodeSamples(const WavFormat &format, std::span<const float> samples, uint8_t *bytes)
+    {
+        if (format.encoding == SampleEncoding::FLOAT)
+        {
+            if (format.bitDepth != 32)
+                throw std::runtime_error("Only 32 bit float WAV output is supported");
+
+            for (std::size_t idx = 0; idx < samples.size(); idx++)
+            {
+                uint32_t bits;
+                std::memcpy(&bits, &samples[idx], sizeof(float));
+                writeLE32(bytes + 4 * idx, bits);
+            }
+            return;
+        }
+
+        std::size_t bytesPerSample = format.bytesPerSample();
+        double fullScale = std::ldexp(1.0, format.bitDepth - 1) - 1.0;
+        for (std::size_t idx = 0; idx < samples.size(); idx++)
+        {
+            double clamped = std::clamp(static_cast<double>(samples[idx]), -1.0, 1.0);
+            int64_t value = std::llround(clamped * fullScale);
+            if (format.bitDepth == 8)
+                value += 128;
+
+            for (std::size_t byte = 0; byte < bytesPerSample; byte++)
+                bytes[bytesPerSample * idx + byte] = static_cast<uint8_t>(value >> (8 * byte));
+        }
+    }
+
+    void encodeSamples(const WavFormat &format, std::span<const int32_t> samples, uint8_t *bytes)
+    {
+        if (format.encoding != SampleEncoding::PCM)
+            throw std::invalid_argument("Integer samples need a PCM WAV format");
+
+        if (format.bitDepth == 24)
+        {
+            pack24(samples, bytes);
+            return;
+        }
+
+        std::size_t bytesPerSample = format.bytesPerSample();
+        int32_t offset = format.bitDepth == 8 ? 128 : 0; // 8 bit WAV is unsigned
+        for (std::size_t idx = 0; idx < samples.size(); idx++)
+        {
+            uint32_t value = static_cast<uint32_t>(samples[idx] + offset);
+            for (std::size_t byte = 0; byte < bytesPerSample; byte++)
+                bytes[bytesPerSample * idx + byte] = static_cast<uint8_t>(value >> (8 * byte));
+        }
+    }
+
+    bool isWritable(const WavFormat &format)
+    {
+        bool depth = format.encoding == SampleEncoding::PCM
+                         ? (format.bitDepth == 8 || format.bitDepth == 16 || format.bitDepth == 24 || format.bitDepth == 32)
+                         : format.bitDepth == 32;
+        return depth && format.channels > 0;
+    }
+
+    void encodeHeader(const WavFormat &format, uint64_t dataBytes, uint8_t *header)
+    {
+        constexpr std::size_t DS64_OFFSET = 12;
+        constexpr uint32_t DS64_BYTES = 28;
+        constexpr std::size_t FMT_OFFSET = DS64_OFFSET + 8 + DS64_BYTES;
+        constexpr std::size_t DATA_OFFSET = FMT_OFFSET + 24;
+
+        // The RIFF size counts everything after its own field
+        uint64_t riffBytes = WAV_HEADER_BYTES - 8 + dataBytes + (dataBytes & 1U);
+        bool rf64 = riffBytes > UINT32_MAX;
+
+        std::memset(header, 0, WAV_HEADER_BYTES);
+        std::memcpy(header, rf64 ? "RF64" : "RIFF", 4);
+        writeLE32(header + 4, rf64 ? UINT32_MAX : static_cast<uint32_t>(riffBytes));
+        std::memcpy(header + 8, "WAVE", 4);
+
+        std::memcpy(header + DS64_OFFSET, rf64 ? "ds64" : "JUNK", 4);
+        writeLE32(header + DS64_OFFSET + 4, DS64_BYTES);
+        if (rf64)
+        {
+            uint8_t *ds64 = header + DS64_OFFSET + 8;
+            writeLE64(ds64, riffBytes);
+            writeLE64(ds64 + 8, dataBytes);
+            writeLE64(ds64 + 16, dataBytes / format.bytesPerFrame());
+        }
+
+        uint8_t *fmt = header + FMT_OFFSET;
+        std::memcpy(fmt, "fmt ", 4);
+        writeLE32(fmt + 4, 16);
+        writeLE16(fmt + 8, format.encoding == SampleEncoding::FLOAT ? 3 : 1);
+        writeLE16(fmt + 10, format.channels);
+        writeLE32(fmt + 12, format.sampleRate);
+        writeLE32(fmt + 16, static_cast<uint32_t>(format.sampleRate * format.bytesPerFrame()));
+        writeLE16(fmt + 20, static_cast<uint16_t>(format.bytesPerFrame()));
+        writeLE16(fmt + 22, format.bitDepth);
+
+        std::memcpy(header + DATA_OFFSET, "data", 4);
+        writeLE32(header + DATA_OFFSET + 4, rf64 ? UINT32_MAX : static_cast<uint32_t>(dataBytes));
+    }
+}
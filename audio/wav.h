@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+
+namespace Audio
+{
+    enum class SampleEncoding
+    {
+        PCM,
+        FLOAT,
+    };
+
+    struct WavFormat
+    {
+        uint16_t channels;
+        uint32_t sampleRate;
+        uint16_t bitDepth;
+        SampleEncoding encoding;
+
+        std::size_t bytesPerSample() const
+        {
+            return bitDepth / 8U;
+        }
+
+        std::size_t bytesPerFrame() const
+        {
+            return bytesPerSample() * channels;
+        }
+    };
+
+    // Little endian field access for the RIFF headers and samples
+    inline uint16_t readLE16(const uint8_t *bytes)
+    {
+        return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+    }
+
+    inline uint32_t readLE32(const uint8_t *bytes)
+    {
+        return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+               (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+
+    inline uint64_t readLE64(const uint8_t *bytes)
+    {
+        return readLE32(bytes) | (static_cast<uint64_t>(readLE32(bytes + 4)) << 32);
+    }
+
+    void writeLE16(uint8_t *bytes, uint16_t value);
+    void writeLE32(uint8_t *bytes, uint32_t value);
+    void writeLE64(uint8_t *bytes, uint64_t value);
+
+    // Sample codecs, each decodes one packed little endian sample to a float in
+    // [-1, 1). PCM follows the usual WAV conventions: 8 bit is unsigned, wider
+    // depths are signed.
+    struct Pcm8
+    {
+        static constexpr std::size_t bytes = 1;
+
+        static float decode(const uint8_t *sample)
+        {
+            return static_cast<float>(static_cast<int>(sample[0]) - 128) / 128.0F;
+        }
+    };
+
+    struct Pcm16
+    {
+        static constexpr std::size_t bytes = 2;
+
+        static float decode(const uint8_t *sample)
+        {
+            return static_cast<float>(static_cast<int16_t>(readLE16(sample))) / 32768.0F;
+        }
+    };
+
+    struct Pcm24
+    {
+        static constexpr std::size_t bytes = 3;
+
+        static float decode(const uint8_t *sample)
+        {
+            // Place in the top of an int32 so the shift back sign extends
+            int32_t value = static_cast<int32_t>((static_cast<uint32_t>(sample[0]) << 8) | (static_cast<uint32_t>(sample[1]) << 16) |
+                                                 (static_cast<uint32_t>(sample[2]) << 24)) >>
+                            8;
+            return static_cast<float>(value) / 8388608.0F;
+        }
+    };
+
+    struct Pcm32
+    {
+        static constexpr std::size_t bytes = 4;
+
+        static float decode(const uint8_t *sample)
+        {
+            return static_cast<float>(static_cast<double>(static_cast<int32_t>(readLE32(sample))) / 2147483648.0);
+        }
+    };
+
+    struct Float32
+    {
+        static constexpr std::size_t bytes = 4;
+
+        static float decode(const uint8_t *sample)
+        {
+            uint32_t bits = readLE32(sample);
+            float value;
+            std::memcpy(&value, &bits, sizeof(float));
+            return value;
+        }
+    };
+
+    struct Float64
+    {
+        static constexpr std::size_t bytes = 8;
+
+        static float decode(const uint8_t *sample)
+        {
+            uint64_t bits = readLE32(sample) | (static_cast<uint64_t>(readLE32(sample + 4)) << 32);
+            double value;
+            std::memcpy(&value, &bits, sizeof(double));
+            return static_cast<float>(value);
+        }
+    };
+
+    // Call f with a default constructed codec matching format
+    template <typename F>
+    decltype(auto) visitCodec(const WavFormat &format, F &&f)
+    {
+        if (format.encoding == SampleEncoding::FLOAT)
+        {
+            switch (format.bitDepth)
+            {
+            case 32:
+                return f(Float32{});
+            case 64:
+                return f(Float64{});
+            default:
+                break;
+            }
+        }
+        else
+        {
+            switch (format.bitDepth)
+            {
+            case 8:
+                return f(Pcm8{});
+            case 16:
+                return f(Pcm16{});
+            case 24:
+                return f(Pcm24{});
+            case 32:
+                return f(Pcm32{});
+            default:
+                break;
+            }
+        }
+        throw std::runtime_error("Unsupported WAV bit depth");
+    }
+
+    // Read the fields of a fmt chunk body, throws for formats no codec handles
+    WavFormat parseFormatChunk(const uint8_t *fmt, std::size_t size);
+
+    // Convert packed samples to and from floats in [-1, 1)
+    void decodeSamples(const WavFormat &format, const uint8_t *bytes, std::span<float> samples);
+    void encodeSamples(const WavFormat &format, std::span<const float> samples, uint8_t *bytes);
+
+    // Pack integer PCM samples as they are, keeping the low bitDepth bits
+    void encodeSamples(const WavFormat &format, std::span<const int32_t> samples, uint8_t *bytes);
+
+    // Formats the writers produce: 8/16/24/32 bit PCM and 32 bit float
+    bool isWritable(const WavFormat &format);
+
+    // The header written ahead of streamed data: RIFF, a JUNK chunk reserving
+    // room for ds64, fmt and the data chunk header. Past 4 GiB it is encoded as
+    // RF64, with the 32 bit sizes set to -1 and the real ones in ds64 (EBU Tech
+    // 3306). Odd data is assumed to be followed by its pad byte.
+    constexpr std::size_t WAV_HEADER_BYTES = 80;
+    void encodeHeader(const WavFormat &format, uint64_t dataBytes, uint8_t *header);
+}
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "wavWriter.h"
+
+// RF64 files pass 4 GiB, off_t must not stop them at 2 GiB on 32 bit builds
+static_assert(sizeof(off_t) == 8, "WavWriter needs _FILE_OFFSET_BITS=64");
+
+namespace Audio
+{
+    WavWriter::WavWriter(const std::string &path, WavFormat format, std::size_t bufferFrames) : wavFormat(format)
+    {
+        if (!isWritable(format))
+            throw std::runtime_error("Unsupported WAV output format for " + path);
+
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            throw std::runtime_error("Failed to open " + path + ": " + std::strerror(errno));
+
+        buffer.resize(std::max<std::size_t>(bufferFrames, 1) * format.bytesPerFrame());
+
+        // Sizes are left empty until the first flush()
+        uint8_t header[WAV_HEADER_BYTES];
+        encodeHeader(format, 0, header);
+        writeAll(header, sizeof(header));
+    }
+
+    WavWriter::~WavWriter()
+    {
+        try
+        {
+            close();
+        }
+        catch (...)
+        {
+            // Nothing sensible to do with an error during destruction
+        }
+    }
+
+    template <typename T, typename Encode>
+    void WavWriter::append(std::span<const T> frames, Encode encode)
+    {
+        if (fd < 0)
+            throw std::runtime_error("WAV writer is closed");
+        if (frames.size() % wavFormat.channels != 0)
+            throw std::invalid_argument("WAV writes must be whole frames");
+
+        std::size_t bytesPerSample = wavFormat.bytesPerSample();
+        while (!frames.empty())
+        {
+            std::size_t space = (buffer.size() - buffered) / bytesPerSample;
+            std::size_t count = std::min(space, frames.size());
+            encode(frames.first(count), buffer.data() + buffered);
+            buffered += count * bytesPerSample;
+            frames = frames.subspan(count);
+
+            if (buffered == buffer.size())
+                writeBuffer();
+        }
+    }
+
+    void WavWriter::write(std::span<const float> frames)
+    {
+        append(frames, [this](std::span<const float> samples, uint8_t *bytes)
+               { encodeSamples(wavFormat, samples, bytes); });
+    }
+
+    void WavWriter::write(std::span<const int32_t> frames)
+    {
+        if (wavFormat.encoding != SampleEncoding::PCM)
+            throw std::invalid_argument("Integer samples need a PCM WAV format");
+
+        append(frames, [this](std::span<const int32_t> samples, uint8_t *bytes)
+               { encodeSamples(wavFormat, samples, bytes); });
+    }
+
+    void WavWriter::flush()
+    {
+        if (fd < 0)
+            throw std::runtime_error("WAV writer is closed");
+
+        writeBuffer();
+        patchHeader();
+    }
+
+    void WavWriter::close()
+    {
+        if (fd < 0)
+            return;
+
+        try
+        {
+            writeBuffer();
+
+            // Chunks are word aligned, odd data is followed by a pad byte
+            // outside the data size
+            uint8_t pad = 0;
+            if (dataBytes & 1U)
+                writeAll(&pad, 1);
+
+            patchHeader();
+        }
+        catch (...)
+        {
+            ::close(fd);
+            fd = -1;
+            throw;
+        }
+
+        ::close(fd);
+        fd = -1;
+    }
+
+    void WavWriter::writeBuffer()
+    {
+        if (buffered == 0)
+            return;
+
+        writeAll(buffer.data(), buffered);
+        dataBytes += buffered;
+        buffered = 0;
+    }
+
+    void WavWriter::patchHeader()
+    {
+        // Data only grows, so once the file is RF64 it stays that way
+        uint8_t header[WAV_HEADER_BYTES];
+        encodeHeader(wavFormat, dataBytes, header);
+        if (::pwrite(fd, header, sizeof(header), 0) != sizeof(header))
+            throw std::runtime_error(std::string("Failed to patch WAV header: ") + std::strerror(errno));
+    }
+
+    void WavWriter::writeAll(const uint8_t *bytes, std::size_t length)
+    {
+        while (length > 0)
+        {
+            ssize_t count = ::write(fd, bytes, length);
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count < 0)
+                throw std::runtime_error(std::string("WAV write failed: ") + std::strerror(errno));
+
+            bytes += count;
+            length -= static_cast<std::size_t>(count);
+        }
+    }
+}
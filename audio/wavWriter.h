@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "wav.h"
+
+namespace Audio
+{
+    // Streams interleaved float frames to a WAV file through a fixed size buffer.
+    // The file is only ever appended to: the header is written with empty sizes
+    // and patched in place by flush() and close(), switching to RF64 once the
+    // data passes 4 GiB. Supports 8/16/24/32 bit PCM and 32 bit float, written
+    // from floats or PCM from raw integers.
+    class WavWriter
+    {
+        int fd = -1;
+        WavFormat wavFormat;
+        uint64_t dataBytes = 0;
+        std::vector<uint8_t> buffer;
+        std::size_t buffered = 0;
+
+    public:
+        WavWriter(const std::string &path, WavFormat format, std::size_t bufferFrames = 4096);
+        ~WavWriter();
+
+        WavWriter(const WavWriter &) = delete;
+        WavWriter &operator=(const WavWriter &) = delete;
+
+        // frames must hold whole interleaved frames
+        void write(std::span<const float> frames);
+
+        // Integer PCM samples stored as they are, keeping the low bitDepth bits
+        // (i.e. 24 bit samples carried in 32 bit words)
+        void write(std::span<const int32_t> frames);
+
+        // Write buffered samples and patch the header sizes, so everything
+        // written so far is readable if the process dies
+        void flush();
+
+        // Flush and close the file, called by the destructor
+        void close();
+
+        const WavFormat &format() const
+        {
+            return wavFormat;
+        }
+
+        uint64_t frames() const
+        {
+            return (dataBytes + buffered) / wavFormat.bytesPerFrame();
+        }
+
+    private:
+        template <typename T, typename Encode>
+        void append(std::span<const T> frames, Encode encode);
+        void writeBuffer();
+        void patchHeader();
+        void writeAll(const uint8_t *bytes, std::size_t length);
+    };
+}
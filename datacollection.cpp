@@ -11,52 +11,15 @@
 #include <boost/log/trivial.hpp>
 
 #include "AudioFile.h"
+#include "asyncwriter.h"
 #include "board.h"
-#include "datawriter.h"
+#include "captureengine.h"
+#include "playbackengine.h"
 #include "ui.h"
 #include "config.h"
 
 using namespace mn::CppLinuxSerial;
 
-struct Recording
-{
-    std::string name;
-    std::size_t file;
-    std::size_t bytesPerSample;
-    std::size_t samplesPerFile;
-    std::size_t recordedSamples;
-
-    Recording(std::string name, std::size_t bytesPerSample, std::size_t samplesPerFile) : name(name), file(0), bytesPerSample(bytesPerSample), samplesPerFile(samplesPerFile), recordedSamples(0) {};
-
-    std::string filename() const
-    {
-        return name + '_' + std::to_string(file) + ".wav";
-    }
-
-    std::size_t total() const
-    {
-        return bytesPerSample * (file * samplesPerFile + recordedSamples);
-    };
-
-    std::string to_str() const
-    {
-        std::stringstream ss;
-        ss << name << " - " << bytesPerSample << " bytes per sample - " << samplesPerFile << " samples per file";
-        return ss.str();
-    }
-};
-
-std::ostream &operator<<(std::ostream &os, Recording &r)
-{
-    os << "Audio file: "
-       << r.filename()
-       << "\tSamples this file: "
-       << r.recordedSamples
-       << "\tTotal size in bytes: "
-       << r.total();
-    return os;
-}
-
 volatile std::sig_atomic_t recordingStopSignal = 0;
 
 void handler(int signal)
@@ -68,20 +31,6 @@ void handler(int signal)
     }
 }
 
-template <typename T>
-void initialiseAudioFile(AudioFile<T> &af, typename AudioFile<T>::AudioBuffer &ab, Recording &r)
-{
-    af.setNumChannels(TOTAL_CHANNELS_DATACOLLECTION);
-    af.setSampleRate(SPS_DATACOLLECTION);
-    af.setBitDepth(BIT_DEPTH_DATACOLLECTION);
-
-    af.setAudioBuffer(ab);
-    af.save(r.filename(), AudioFileFormat::Wave);
-
-    BOOST_LOG_TRIVIAL(debug)
-        << "init audiofile " << r.filename();
-}
-
 int main(int argc, char* argv[]) {
     if (argc != 2) {
         BOOST_LOG_TRIVIAL(error) << "Usage: " << argv[0] << " <wav_file_name>";
@@ -132,31 +81,37 @@ int main(int argc, char* argv[]) {
     oss << std::put_time(&now_tm, "%Y-%m-%d_%H-%M-%S");
     std::string name = FILENAME_DATACOLLECTION + '_' + oss.str();
 
-    Recording r(name, BYTES_PER_SAMPLE, SAMPLES_PER_FILE);
-
-    // prep audio buffer
-    constexpr std::size_t BUFFER_LENGTH = SPS_DATACOLLECTION * BUFFER_SAVE_SECONDS_DATACOLLECTION;
-    std::size_t currentChannel = 0;
-    AudioFile<int32_t>::AudioBuffer audioBuffer;
-    audioBuffer.resize(TOTAL_CHANNELS_DATACOLLECTION);
-    std::ranges::for_each(audioBuffer, [&BUFFER_LENGTH](auto &b)
-                          { b.reserve(BUFFER_LENGTH); });
+    DataWriterConfig files;
+    files.name = name;
+    files.format = Audio::WavFormat{TOTAL_CHANNELS_DATACOLLECTION, SPS_DATACOLLECTION, BIT_DEPTH_DATACOLLECTION, Audio::SampleEncoding::PCM};
+    files.framesPerFile = SAMPLES_PER_FILE / TOTAL_CHANNELS_DATACOLLECTION;
+    files.secondsPerFile = RECORD_FILE_SECONDS;
+    files.syncBytes = WRITER_SYNC_BYTES;
+    files.direct = WRITER_DIRECT_IO;
 
-    // prep audio file
-    AudioFile<int32_t> audioFile;
-    initialiseAudioFile(audioFile, audioBuffer, r);
-
-    BOOST_LOG_TRIVIAL(info) << r.to_str();
+    // received samples are appended to the files from a writer thread
+    AsyncWriter writer(files, fpga.dma.transferLength() / sizeof(uint32_t), WRITER_POOL_BYTES);
     std::signal(SIGINT, handler);
 
-    uint64_t inputIdx = 0;
     uint64_t inputFileNumSamples = inputFile.getNumSamplesPerChannel();
     BOOST_LOG_TRIVIAL(info) << "inputFileNumSamples " << inputFileNumSamples;
     inputFileNumSamples = (inputFileNumSamples % 2 == 0) ? inputFileNumSamples : inputFileNumSamples - 1;
     BOOST_LOG_TRIVIAL(info) << "inputFileNumSamples updated to " << inputFileNumSamples;
-    fpga.dma.sendData(inputFile.samples[0], inputIdx);
-    inputIdx += 2;
-    while (inputIdx < inputFileNumSamples && !recordingStopSignal)
+    // the capture thread copies each DMA block into the ring and re-arms at
+    // once, and the stimulus streams out through MM2S on its own thread meanwhile
+    SpscRing<uint32_t> captured(CAPTURE_RING_SAMPLES);
+    CaptureEngine capture(fpga.dma, CAPTURE_BUFFERS);
+    capture.attach(captured);
+    PlaybackEngine playback(fpga.dma, PLAYBACK_DEPTH);
+    uint64_t reportedOverruns = 0;
+    uint64_t reportedRingDrops = 0;
+    uint64_t reportedDrops = 0;
+    capture.start();
+
+    std::span<const int32_t> input(inputFile.samples[0].data(), inputFileNumSamples);
+    playback.start(input);
+    auto lastReceived = std::chrono::steady_clock::now();
+    while (!recordingStopSignal)
     {
         if (fpga.dma.status == Status::ERROR)
         {
@@ -164,64 +119,60 @@ int main(int argc, char* argv[]) {
             recordingStopSignal = 1;
         }
 
-        if (r.recordedSamples >= SAMPLES_PER_FILE)
+        // done once everything sent has come back, or the loopback went quiet
+        auto now = std::chrono::steady_clock::now();
+        if (playback.done() && (playback.pending() == 0 || now - lastReceived > PLAYBACK_DRAIN_TIMEOUT))
+            break;
+
+        if (capture.overruns() != reportedOverruns)
         {
-            BOOST_LOG_TRIVIAL(info) << "save audiofile " << r.filename();
-            audioFile.setAudioBuffer(audioBuffer);
-            audioFile.save(r.filename(), AudioFileFormat::Wave);
-
-            r.file++;
-            r.recordedSamples = 0;
-            std::ranges::for_each(audioBuffer, [&BUFFER_LENGTH](auto &b)
-                                  { b.clear();
-                                    b.reserve(BUFFER_LENGTH); });
-            initialiseAudioFile(audioFile, audioBuffer, r);
+            reportedOverruns = capture.overruns();
+            BOOST_LOG_TRIVIAL(warning) << "capture overruns " << reportedOverruns;
         }
-        else if (r.recordedSamples == audioBuffer.begin()->capacity())
+        if (capture.ringDrops() != reportedRingDrops)
         {
-            // save wip
-            audioFile.setAudioBuffer(audioBuffer);
-            BOOST_LOG_TRIVIAL(info) << "save audiofile " << r.filename();
-            audioFile.save(r.filename(), AudioFileFormat::Wave);
-
-            // increase buffer size
-            size_t newBufferSize = audioBuffer[0].capacity() + (SPS_DATACOLLECTION * BUFFER_SAVE_SECONDS_DATACOLLECTION);
-            BOOST_LOG_TRIVIAL(debug)
-                << "increase audio file buffer size from "
-                << audioBuffer[0].capacity()
-                << " to "
-                << newBufferSize;
-            std::ranges::for_each(audioBuffer, [newBufferSize](auto &b)
-                                  { b.reserve(newBufferSize); });
+            reportedRingDrops = capture.ringDrops();
+            BOOST_LOG_TRIVIAL(warning) << "capture ring dropped samples " << reportedRingDrops;
+        }
+        if (writer.drops() != reportedDrops)
+        {
+            reportedDrops = writer.drops();
+            BOOST_LOG_TRIVIAL(warning) << "writer dropped samples " << reportedDrops;
         }
 
-        // record sample packet
-        int bytesRecorded = fpga.dma.fillBuffer();
-
-        //volatile int audioBufferLength = audioBuffer[0].size();
-        auto sampleIt = fpga.dma.buffer.begin();
-        while (sampleIt != fpga.dma.buffer.end())
+        // store whole frames as they become available
+        auto frames = captured.peek();
+        frames = frames.first(frames.size() - frames.size() % TOTAL_CHANNELS_DATACOLLECTION);
+        if (frames.empty())
         {
-            // BOOST_LOG_TRIVIAL(info) << "got sample " << *sampleIt;
-            audioBuffer[currentChannel].push_back(*sampleIt);
-            sampleIt++;
-            r.recordedSamples++;
-            currentChannel = (currentChannel == TOTAL_CHANNELS_DATACOLLECTION - 1) ? 0 : currentChannel + 1;
+            std::this_thread::yield();
+            continue;
         }
-        fpga.dma.buffer.clear();
 
-        // transfer audio
-        // BOOST_LOG_TRIVIAL(info) << "sent samples " << inputFile.samples[0][inputIdx] << " " << inputFile.samples[0][inputIdx + 1];
-        fpga.dma.sendData(inputFile.samples[0], inputIdx);
-        inputIdx += 2;
-    }
-    // save file
-    if (r.recordedSamples != 0)
-    {
-        BOOST_LOG_TRIVIAL(info)
-            << "save audiofile " << r.filename();
-        audioFile.save(r.filename(), AudioFileFormat::Wave);
+        writer.push(frames);
+        captured.consume(frames.size());
+        playback.acknowledge(frames.size());
+        lastReceived = now;
     }
+    playback.stop();
+    capture.stop();
+    BOOST_LOG_TRIVIAL(info) << "captured " << capture.blocks() << " blocks with " << capture.overruns() << " overruns";
+
+    auto loop = playback.metrics();
+    if (loop.sentSamples != loop.receivedSamples)
+        BOOST_LOG_TRIVIAL(warning) << "sent " << loop.sentSamples << " samples but received " << loop.receivedSamples;
+    BOOST_LOG_TRIVIAL(info) << "played " << loop.sentSamples << " samples, " << loop.maxInFlight << " in flight at most, "
+                            << loop.creditStalls << " credit stalls, round trip latency last "
+                            << loop.lastLatency.count() << " us max " << loop.maxLatency.count() << " us";
+
+    // write out what is queued and finalise the last file
+    writer.stop();
+    auto metrics = writer.metrics();
+    BOOST_LOG_TRIVIAL(info) << "wrote " << metrics.blocksWritten << " blocks, "
+                            << metrics.droppedSamples << " samples dropped, queue depth max "
+                            << metrics.maxQueueDepth << ", write latency mean "
+                            << metrics.meanWriteLatency.count() << " us max "
+                            << metrics.maxWriteLatency.count() << " us";
 
     BOOST_LOG_TRIVIAL(info) << "data collection completed!";
 
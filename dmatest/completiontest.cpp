@@ -0,0 +1,126 @@
+/*
+ * Exercises the DMA completion backends without the FPGA. An eventfd stands in
+ * for the /dev/uioN interrupt fd and a thread stands in for the DMA, setting
+ * the "status register" and raising the "interrupt".
+ *
+ * Usage: completiontest
+ */
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdint.h>
+#include <thread>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "Completion.h"
+
+using namespace std::chrono;
+
+static int failures = 0;
+
+static void check(bool ok, const char *name, microseconds elapsed)
+{
+    printf("%s %-40s %8lld us\n", ok ? "PASS" : "FAIL", name, (long long)elapsed.count());
+    if (!ok)
+        failures++;
+}
+
+/* Raise the fake interrupt after delay, optionally without completing */
+static std::thread fakeDma(int fd, std::atomic<bool> &status, milliseconds delay, bool complete)
+{
+    return std::thread([=, &status]() {
+        std::this_thread::sleep_for(delay);
+        if (complete)
+            status = true;
+        uint64_t irq = 1;
+        if (write(fd, &irq, sizeof(irq)) != sizeof(irq))
+            perror("eventfd write");
+    });
+}
+
+int main()
+{
+    int fd = eventfd(0, EFD_CLOEXEC);
+    if (fd < 0)
+    {
+        perror("eventfd");
+        return 1;
+    }
+
+    IrqCompletion irq(fd, false);
+    std::atomic<bool> status{false};
+    auto done = [&]() { return status.load(); };
+
+    /* Sleeps until the interrupt, then sees the status */
+    {
+        status = false;
+        auto dma = fakeDma(fd, status, milliseconds(20), true);
+        auto start = steady_clock::now();
+        bool ok = irq.Wait(done, seconds(1));
+        auto elapsed = duration_cast<microseconds>(steady_clock::now() - start);
+        dma.join();
+        check(ok && elapsed >= milliseconds(20) && irq.GetWakeupCount() == 1, "irq: wakes on interrupt", elapsed);
+    }
+
+    /* Completed before waiting, must not sleep */
+    {
+        status = true;
+        auto start = steady_clock::now();
+        bool ok = irq.Wait(done, seconds(1));
+        auto elapsed = duration_cast<microseconds>(steady_clock::now() - start);
+        check(ok && elapsed < milliseconds(5), "irq: already complete", elapsed);
+    }
+
+    /* Interrupt without completion (i.e. another channel), keeps waiting */
+    {
+        status = false;
+        auto spurious = fakeDma(fd, status, milliseconds(5), false);
+        auto dma = fakeDma(fd, status, milliseconds(30), true);
+        auto start = steady_clock::now();
+        bool ok = irq.Wait(done, seconds(1));
+        auto elapsed = duration_cast<microseconds>(steady_clock::now() - start);
+        spurious.join();
+        dma.join();
+        check(ok && elapsed >= milliseconds(30), "irq: ignores spurious interrupt", elapsed);
+    }
+
+    /* No interrupt, times out */
+    {
+        status = false;
+        auto start = steady_clock::now();
+        bool ok = irq.Wait(done, milliseconds(50));
+        auto elapsed = duration_cast<microseconds>(steady_clock::now() - start);
+        check(!ok && elapsed >= milliseconds(50), "irq: timeout", elapsed);
+    }
+    check(irq.GetInterruptCount() == 3, "irq: interrupt count", microseconds(0));
+
+    /* Adaptive polling needs no interrupt */
+    {
+        PollingCompletion polling;
+        status = false;
+        auto dma = fakeDma(fd, status, milliseconds(20), true);
+        auto start = steady_clock::now();
+        bool ok = polling.Wait(done, seconds(1));
+        auto elapsed = duration_cast<microseconds>(steady_clock::now() - start);
+        dma.join();
+        check(ok && elapsed < milliseconds(25), "polling: completes", elapsed);
+
+        status = false;
+        start = steady_clock::now();
+        ok = polling.Wait(done, milliseconds(50));
+        elapsed = duration_cast<microseconds>(steady_clock::now() - start);
+        check(!ok && elapsed >= milliseconds(50), "polling: timeout", elapsed);
+    }
+
+    /* Missing device falls back to polling */
+    {
+        auto completion = MakeCompletion("/dev/uio-does-not-exist");
+        check(dynamic_cast<PollingCompletion *>(completion.get()) != nullptr, "missing device falls back", microseconds(0));
+    }
+
+    close(fd);
+    printf("%d failure(s)\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+/* Copyright (C) 2024-2025 Tom Pacino.  All rights reserved.
+ *
+ * Contact author for permissions t.pacino@unsw.edu.au
+ */
+
+#pragma once
+
+#include <concepts>
+#include <cstdint>
+#include <type_traits>
+
+#include "cnl/all.h"
+
+namespace LMS
+{
+  // Type that sums of products of T are accumulated in. Fixed point types use a
+  // wider integer so every product is kept at full precision and the sum is only
+  // rounded back to T once, the same as the multiply-accumulate on the FPGA.
+  // Floating point types accumulate in T.
+  template <typename T>
+  struct Accumulator
+  {
+    using type = T;
+
+    static type product(T a, T b)
+    {
+      return a * b;
+    }
+  };
+
+  template <std::integral T>
+  struct Accumulator<T>
+  {
+    using type = std::conditional_t<std::is_signed_v<T>, std::int64_t, std::uint64_t>;
+
+    static type product(T a, T b)
+    {
+      return static_cast<type>(a) * static_cast<type>(b);
+    }
+  };
+
+  // Products of scaled_integer<Rep, power<E>> are formed in a 64 bit rep, so
+  // the exact product lands at exponent 2E and sums carry no rounding until
+  // the final conversion back to T. Declared with the primary template so
+  // every instantiation sees it.
+  template <typename Rep, int Exponent, int Radix>
+  struct Accumulator<cnl::scaled_integer<Rep, cnl::power<Exponent, Radix>>>
+  {
+    using T = cnl::scaled_integer<Rep, cnl::power<Exponent, Radix>>;
+    using Operand = cnl::scaled_integer<std::int64_t, cnl::power<Exponent, Radix>>;
+    using type = decltype(Operand{} * Operand{});
+
+    static type product(T a, T b)
+    {
+      return Operand{a} * Operand{b};
+    }
+  };
+
+  template <typename T>
+  using Wide = typename Accumulator<T>::type;
+}
@@ -0,0 +1,200 @@
+/* Copyright (C) 2024-2025 Tom Pacino.  All rights reserved.
+ *
+ * Contact author for permissions t.pacino@unsw.edu.au
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "spscQueue.h"
+
+// Runs independent per-channel filter stages on a fixed pool of worker threads
+// pinned to cores. Each channel is owned by one worker (channel % workers), so a
+// channel's blocks are always processed in order by the same thread and stage
+// state needs no locking. Jobs are handed over and returned through lock-free
+// SPSC queues; idle workers sleep on an atomic wait rather than spinning.
+//
+// Job must have a std::size_t channel member. Stage must be callable as
+// stage(job). Jobs are passed by pointer and stay owned by the caller until
+// they come back through collect or drain.
+template <typename Job, typename Stage, std::size_t QueueDepth = 64>
+class ChannelPipeline
+{
+    struct Worker
+    {
+        SpscQueue<Job *, QueueDepth> input;
+        SpscQueue<Job *, QueueDepth> output;
+        std::atomic<std::uint32_t> signal{0};
+        std::size_t outstanding = 0; // Producer side only
+        std::thread thread;
+    };
+
+    std::vector<Stage> stages;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<bool> running{true};
+
+public:
+    // cores lists the core for each worker, by default worker w runs on core w
+    ChannelPipeline(std::vector<Stage> channelStages, std::size_t workerCount, std::span<const int> cores = {}) : stages(std::move(channelStages))
+    {
+        if (workerCount == 0 || stages.empty())
+            throw std::invalid_argument("ChannelPipeline requires at least one worker and one channel");
+        // CPU_SET is undefined outside the set
+        if (std::ranges::any_of(cores, [](int core) { return core < 0 || core >= CPU_SETSIZE; }))
+            throw std::invalid_argument("ChannelPipeline cores must be between 0 and CPU_SETSIZE");
+
+        unsigned int hardwareCores = std::max(1U, std::thread::hardware_concurrency());
+        try
+        {
+            for (std::size_t idx = 0; idx < workerCount; idx++)
+            {
+                workers.push_back(std::make_unique<Worker>());
+                Worker &worker = *workers.back();
+                worker.thread = std::thread([this, &worker]
+                                            { work(worker); });
+
+                int core = idx < cores.size() ? cores[idx] : static_cast<int>(idx % hardwareCores);
+                pin(worker.thread, core);
+            }
+        }
+        catch (...)
+        {
+            // The destructor will not run, join the workers already started
+            shutdown();
+            throw;
+        }
+    }
+
+    ChannelPipeline(const ChannelPipeline &) = delete;
+    ChannelPipeline &operator=(const ChannelPipeline &) = delete;
+
+    ~ChannelPipeline()
+    {
+        shutdown();
+    }
+
+    std::size_t channels() const
+    {
+        return stages.size();
+    }
+
+    // Only safe to touch while the channel has no jobs in flight
+    Stage &stage(std::size_t channel)
+    {
+        return stages.at(channel);
+    }
+
+    // Producer only. Returns false if the owning worker already holds
+    // QueueDepth jobs; collect some before trying again. Throws
+    // std::out_of_range for a channel without a stage.
+    bool submit(Job *job)
+    {
+        if (job->channel >= stages.size())
+            throw std::out_of_range("ChannelPipeline job channel has no stage");
+
+        Worker &worker = owner(job->channel);
+        if (worker.outstanding == QueueDepth || !worker.input.push(job))
+            return false;
+
+        worker.outstanding++;
+        worker.signal.fetch_add(1, std::memory_order_release);
+        worker.signal.notify_one();
+        return true;
+    }
+
+    // Producer only. Hands every completed job to onDone, returns how many
+    template <typename OnDone>
+    std::size_t collect(OnDone &&onDone)
+    {
+        std::size_t collected = 0;
+        for (auto &worker : workers)
+        {
+            Job *job = nullptr;
+            while (worker->output.pop(job))
+            {
+                worker->outstanding--;
+                collected++;
+                onDone(*job);
+            }
+        }
+        return collected;
+    }
+
+    // Producer only. Waits until every submitted job has been collected
+    template <typename OnDone>
+    void drain(OnDone &&onDone)
+    {
+        while (inFlight() > 0)
+            if (collect(onDone) == 0)
+                std::this_thread::yield();
+    }
+
+    std::size_t inFlight() const
+    {
+        std::size_t total = 0;
+        for (const auto &worker : workers)
+            total += worker->outstanding;
+        return total;
+    }
+
+private:
+    void shutdown()
+    {
+        running.store(false, std::memory_order_release);
+        for (auto &worker : workers)
+        {
+            worker->signal.fetch_add(1, std::memory_order_release);
+            worker->signal.notify_one();
+        }
+        for (auto &worker : workers)
+            if (worker->thread.joinable())
+                worker->thread.join();
+    }
+
+    Worker &owner(std::size_t channel)
+    {
+        return *workers[channel % workers.size()];
+    }
+
+    void work(Worker &worker)
+    {
+        while (true)
+        {
+            std::uint32_t seen = worker.signal.load(std::memory_order_acquire);
+
+            Job *job = nullptr;
+            if (worker.input.pop(job))
+            {
+                stages[job->channel](*job);
+                // Never full, a worker holds at most QueueDepth outstanding jobs
+                worker.output.push(job);
+                continue;
+            }
+
+            if (!running.load(std::memory_order_acquire))
+                return;
+
+            worker.signal.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    static void pin(std::thread &thread, int core)
+    {
+        // Best effort, an unpinned worker still runs correctly
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(core, &cpuset);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpuset);
+    }
+};
@@ -0,0 +1,59 @@
+/* Copyright (C) 2024-2025 Tom Pacino.  All rights reserved.
+ *
+ * Contact author for permissions t.pacino@unsw.edu.au
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <ranges>
+
+// Pearson correlation of two signals accumulated one pair at a time, so it
+// needs no sample history. Uses Welford's updates for the means and
+// (co)moments, which stay accurate over very long recordings.
+template <typename T = double>
+class Correlation
+{
+    std::size_t count = 0;
+    T meanX = 0;
+    T meanY = 0;
+    T m2X = 0;
+    T m2Y = 0;
+    T coMoment = 0;
+
+public:
+    void add(T x, T y)
+    {
+        count++;
+        T dx = x - meanX;
+        meanX += dx / static_cast<T>(count);
+        T dy = y - meanY;
+        meanY += dy / static_cast<T>(count);
+
+        m2X += dx * (x - meanX);
+        m2Y += dy * (y - meanY);
+        coMoment += dx * (y - meanY);
+    }
+
+    // Add corresponding pairs of two ranges, stops at the end of the shorter
+    template <std::ranges::input_range X, std::ranges::input_range Y>
+    void add(X &&x, Y &&y)
+    {
+        auto yIt = std::ranges::begin(y);
+        auto yEnd = std::ranges::end(y);
+        for (auto xIt = std::ranges::begin(x); xIt != std::ranges::end(x) && yIt != yEnd; ++xIt, ++yIt)
+            add(static_cast<T>(*xIt), static_cast<T>(*yIt));
+    }
+
+    // NaN until both signals have some variance, the same as gsl_stats_correlation
+    T value() const
+    {
+        return coMoment / std::sqrt(m2X * m2Y);
+    }
+
+    std::size_t samples() const
+    {
+        return count;
+    }
+};
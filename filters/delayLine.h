@@ -0,0 +1,69 @@
+/* Copyright (C) 2024-2025 Tom Pacino.  All rights reserved.
+ *
+ * Contact author for permissions t.pacino@unsw.edu.au
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <span>
+
+namespace LMS
+{
+  // Tapped delay line backed by a double-length mirrored buffer. Every sample is
+  // written twice (at head and head + Taps) so the newest Taps samples are always
+  // contiguous from head, newest first. Pushing is O(1) and no data is moved.
+  template <typename T, std::size_t Taps>
+  class DelayLine
+  {
+    static_assert(Taps > 0, "DelayLine requires at least one tap");
+
+    std::array<T, 2 * Taps> buffer;
+    std::size_t head = 0;
+
+  public:
+    DelayLine()
+    {
+      buffer.fill(0);
+    }
+
+    // Push the newest sample and return the oldest sample that has left the line
+    T push(T sample)
+    {
+      head = (head == 0) ? Taps - 1 : head - 1;
+
+      // Both halves are mirrored, so the slot being overwritten holds the oldest sample
+      T oldest = buffer[head];
+      buffer[head] = sample;
+      buffer[head + Taps] = sample;
+      return oldest;
+    }
+
+    // Sample idx steps in the past, 0 is the newest
+    T operator[](std::size_t idx) const
+    {
+      return buffer[head + idx];
+    }
+
+    const T *data() const
+    {
+      return buffer.data() + head;
+    }
+
+    std::span<const T, Taps> window() const
+    {
+      return std::span<const T, Taps>(data(), Taps);
+    }
+
+    auto begin() const
+    {
+      return window().begin();
+    }
+
+    auto end() const
+    {
+      return window().end();
+    }
+  };
+}
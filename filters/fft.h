@@ -0,0 +1,100 @@
+/* Copyright (C) 2024-2025 Tom Pacino.  All rights reserved.
+ *
+ * Contact author for permissions t.pacino@unsw.edu.au
+ */
+
+#pragma once
+
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <numbers>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace LMS
+{
+  // Plain complex product, std::complex operator* takes a slow NaN/inf recovery path
+  template <typename R>
+  std::complex<R> multiply(std::complex<R> a, std::complex<R> b)
+  {
+    return std::complex<R>(a.real() * b.real() - a.imag() * b.imag(),
+                           a.real() * b.imag() + a.imag() * b.real());
+  }
+
+  // In-place iterative radix-2 FFT of a fixed power-of-two size. Twiddle factors
+  // and the bit reversal permutation are computed once at construction.
+  template <typename R, std::size_t Size>
+  class FFT
+  {
+    static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "FFT size must be a power of two");
+
+    std::vector<std::complex<R>> twiddle;
+    std::vector<std::size_t> reversed;
+
+  public:
+    FFT() : twiddle(Size / 2), reversed(Size)
+    {
+      for (std::size_t k = 0; k < Size / 2; k++)
+      {
+        R angle = -2 * std::numbers::pi_v<R> * static_cast<R>(k) / static_cast<R>(Size);
+        twiddle[k] = std::complex<R>(std::cos(angle), std::sin(angle));
+      }
+
+      std::size_t bits = 0;
+      while ((std::size_t{1} << bits) < Size)
+        bits++;
+
+      for (std::size_t idx = 0; idx < Size; idx++)
+      {
+        std::size_t rev = 0;
+        for (std::size_t bit = 0; bit < bits; bit++)
+          rev |= ((idx >> bit) & 1U) << (bits - 1 - bit);
+        reversed[idx] = rev;
+      }
+    }
+
+    void forward(std::span<std::complex<R>, Size> data) const
+    {
+      transform<false>(data);
+    }
+
+    // Inverse transform, scaled by 1 / Size
+    void inverse(std::span<std::complex<R>, Size> data) const
+    {
+      transform<true>(data);
+      R scale = R{1} / static_cast<R>(Size);
+      for (auto &value : data)
+        value *= scale;
+    }
+
+  private:
+    template <bool Inverse>
+    void transform(std::span<std::complex<R>, Size> data) const
+    {
+      for (std::size_t idx = 0; idx < Size; idx++)
+        if (idx < reversed[idx])
+          std::swap(data[idx], data[reversed[idx]]);
+
+      for (std::size_t length = 2; length <= Size; length *= 2)
+      {
+        std::size_t half = length / 2;
+        std::size_t stride = Size / length;
+        for (std::size_t start = 0; start < Size; start += length)
+        {
+          for (std::size_t k = 0; k < half; k++)
+          {
+            std::complex<R> w = twiddle[k * stride];
+            if constexpr (Inverse)
+              w = std::conj(w);
+
+            std::complex<R> odd = multiply(w, data[start + k + half]);
+            data[start + k + half] = data[start + k] - odd;
+            data[start + k] += odd;
+          }
+        }
+      }
+    }
+  };
+}
@@ -0,0 +1,463 @@
+/*
+ * Checks the filter and sample kernels against their plain references and
+ * reports their throughput, so changes to the fixed point, SIMD or block
+ * paths can be verified without recordings.
+ *
+ * Usage: filtertest
+ *
+ * The cnl fixed point checks are only built with -DFILTERTEST_FIXED_POINT=ON.
+ */
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <stdio.h>
+#include <type_traits>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "cnl/all.h"
+
+#include "interleave.h"
+#include "leakyIntegrator.h"
+#include "lms.h"
+#include "lmsBank.h"
+#include "lmsKernels.h"
+#include "spscQueue.h"
+
+/* The vector kernels are bit-identical to the scalar ones at every length */
+static bool kernelTest()
+{
+    constexpr std::size_t longest = 300;
+    std::vector<float> h(longest);
+    std::vector<float> x(longest);
+    for (std::size_t idx = 0; idx < longest; idx++)
+    {
+        h[idx] = std::sin(0.37F * idx) / (1.0F + idx);
+        x[idx] = std::cos(1.91F * idx) * 3.0F;
+    }
+
+    std::size_t mismatches = 0;
+    for (std::size_t n = 1; n <= longest; n++)
+    {
+        float kernel = LMS::kernels::dot(h.data(), x.data(), n);
+        float scalar = LMS::kernels::dotScalar(h.data(), x.data(), n);
+        mismatches += std::bit_cast<uint32_t>(kernel) != std::bit_cast<uint32_t>(scalar);
+
+        std::vector<float> updated(h.begin(), h.begin() + n);
+        std::vector<float> reference(updated);
+        LMS::kernels::accumulate(updated.data(), x.data(), n, 0.013F);
+        LMS::kernels::accumulateScalar(reference.data(), x.data(), n, 0.013F);
+        for (std::size_t idx = 0; idx < n; idx++)
+            mismatches += std::bit_cast<uint32_t>(updated[idx]) != std::bit_cast<uint32_t>(reference[idx]);
+    }
+
+    bool ok = mismatches == 0;
+    printf("%s kernels  %zu mismatches\n", ok ? "PASS" : "FAIL", mismatches);
+    return ok;
+}
+
+/* The frequency domain filter identifies a random system, its errors lagging by latency() */
+static bool fdafTest()
+{
+    constexpr std::size_t taps = 32;
+    using Filter = LMS::FDAF<double, taps, true>;
+    static_assert(Filter::latency() == taps);
+
+    uint32_t seed = 12345;
+    auto noise = [&]
+    {
+        seed = seed * 1664525U + 1013904223U;
+        return static_cast<double>(seed >> 8) / (1U << 24) - 0.5;
+    };
+
+    std::vector<double> system(taps);
+    for (auto &tap : system)
+        tap = noise();
+
+    Filter filter(0.5);
+    constexpr std::size_t samples = 40000;
+    std::vector<double> history(taps);
+    std::vector<double> desired(samples);
+    bool lagged = true;
+    double squared = 0;
+    for (std::size_t idx = 0; idx < samples; idx++)
+    {
+        history.insert(history.begin(), noise());
+        history.pop_back();
+        for (std::size_t tap = 0; tap < taps; tap++)
+            desired[idx] += system[tap] * history[tap];
+
+        double error = filter.step(history[0], desired[idx]);
+
+        // The first block is filtered with zero taps, so its errors come out
+        // as the desired samples, latency() steps late
+        if (idx < Filter::latency())
+            lagged = lagged && error == 0;
+        else if (idx < 2 * Filter::latency())
+            lagged = lagged && error == desired[idx - Filter::latency()];
+        if (idx >= samples - 1000)
+            squared += error * error;
+    }
+
+    double mse = squared / 1000;
+    bool ok = lagged && mse < 1e-10;
+    printf("%s fdaf     final mse %g%s\n", ok ? "PASS" : "FAIL", mse, lagged ? "" : ", errors not lagged by latency()");
+    return ok;
+}
+
+/* A bank of channels matches one VSS filter per channel bit for bit */
+static bool bankTest()
+{
+    constexpr std::size_t taps = 8;
+    constexpr std::size_t channels = 3;
+    constexpr float stepSize = 0.01F;
+    constexpr float alpha = 0.9F;
+    constexpr float gamma = 0.1F;
+
+    LMS::Bank<float, taps, channels> bank(stepSize, alpha, gamma);
+    std::vector<LMS::VSS<float, taps, true>> filters;
+    filters.reserve(channels);
+    for (std::size_t ch = 0; ch < channels; ch++)
+        filters.emplace_back(stepSize, alpha, gamma);
+
+    // Frames of interleaved channels, each with its own input and system
+    constexpr std::size_t frames = 5000;
+    std::vector<float> x(frames * channels);
+    std::vector<float> d(frames * channels);
+    for (std::size_t idx = 0; idx < x.size(); idx++)
+    {
+        std::size_t ch = idx % channels;
+        x[idx] = std::sin(0.03F * idx + ch) + 0.3F * std::sin(0.71F * idx * (ch + 1));
+        d[idx] = (0.4F + 0.2F * ch) * x[idx] - (idx >= channels ? 0.3F * x[idx - channels] : 0.0F);
+    }
+
+    std::vector<float> e(x.size());
+    bank.process(x, d, e);
+
+    std::size_t mismatches = 0;
+    for (std::size_t idx = 0; idx < x.size(); idx++)
+    {
+        float reference = filters[idx % channels].step(x[idx], d[idx]);
+        mismatches += std::bit_cast<uint32_t>(reference) != std::bit_cast<uint32_t>(e[idx]);
+    }
+
+    bool ok = mismatches == 0;
+    printf("%s bank     %zu mismatches\n", ok ? "PASS" : "FAIL", mismatches);
+    return ok;
+}
+
+#if defined(FILTERTEST_FIXED_POINT)
+using Fixed = cnl::scaled_integer<int16_t, cnl::power<-14>>;
+
+/* A system identified in fixed point tracks the same filter run in float */
+static bool fixedTest()
+{
+    // The 64 bit accumulator is chosen without including anything else
+    static_assert(std::is_same_v<LMS::Wide<Fixed>, cnl::scaled_integer<int64_t, cnl::power<-28>>>);
+
+    constexpr std::size_t taps = 4;
+    constexpr float stepSize = 0.05F;
+    const float system[taps] = {0.5F, -0.25F, 0.125F, 0.0625F};
+
+    LMS::FSS<Fixed, taps, false> fixed(Fixed{stepSize});
+    LMS::FSS<float, taps, false> reference(stepSize);
+
+    std::vector<float> history(taps);
+    float maxDifference = 0;
+    float lastError = 0;
+    for (std::size_t idx = 0; idx < 20000; idx++)
+    {
+        float x = 0.5F * std::sin(0.05F * idx) + 0.25F * std::sin(0.31F * idx);
+        history.insert(history.begin(), x);
+        history.pop_back();
+        float d = 0;
+        for (std::size_t tap = 0; tap < taps; tap++)
+            d += system[tap] * history[tap];
+
+        float fixedError = float{fixed.step(Fixed{x}, Fixed{d})};
+        float referenceError = reference.step(x, d);
+        maxDifference = std::max(maxDifference, std::fabs(fixedError - referenceError));
+        lastError = std::fabs(fixedError);
+    }
+
+    // Q1.14 resolves about 6e-5, the filters stay within a few of those
+    bool ok = maxDifference < 2e-3F && lastError < 2e-3F;
+    printf("%s fixed    max difference %g  final error %g\n", ok ? "PASS" : "FAIL", maxDifference, lastError);
+    return ok;
+}
+
+/* The integer normalisation matches a float divide to its Q1.14 resolution */
+static bool divideTest()
+{
+    float maxDifference = 0;
+    for (int numerator = -16384; numerator < 16384; numerator += 97)
+    {
+        for (float denominator = 0.01F; denominator < 64.0F; denominator *= 1.37F)
+        {
+            Fixed n{numerator / 16384.0F};
+            LMS::Wide<Fixed> d{denominator};
+            float expected = std::clamp(float{n} / float{d}, -2.0F, 2.0F - 1.0F / 16384);
+            maxDifference = std::max(maxDifference, std::fabs(float{LMS::divide<Fixed>(n, d)} - expected));
+        }
+    }
+
+    bool ok = maxDifference <= 2.0F / 16384;
+    printf("%s divide   max difference %g\n", ok ? "PASS" : "FAIL", maxDifference);
+    return ok;
+}
+
+#endif
+
+/* Float NLMS without regularisation skips normalising while the input is silent */
+static bool silenceTest()
+{
+    LMS::FSS<float, 4, true> filter(0.1F, 0.0F);
+    bool ok = LMS::divide<float>(0.5F, 0.0F) == 0.5F;
+    for (std::size_t idx = 0; idx < 100; idx++)
+    {
+        float x = idx < 10 ? 0.0F : std::sin(0.2F * idx);
+        ok = ok && std::isfinite(filter.step(x, 0.5F * x + 1.0F));
+    }
+
+    printf("%s silence\n", ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+/* Interleave kernels round trip every channel count and match the scalar loop */
+static bool interleaveTest()
+{
+    bool ok = true;
+    for (std::size_t channels = 1; channels <= 9; channels++)
+    {
+        // Odd frame counts leave a tail for the scalar loop
+        constexpr std::size_t frames = 1001;
+        std::vector<int32_t> input(frames * channels);
+        for (std::size_t idx = 0; idx < input.size(); idx++)
+            input[idx] = static_cast<int32_t>(idx * 2654435761U);
+
+        std::vector<int32_t> planar(frames * channels);
+        std::vector<std::span<int32_t>> split;
+        std::vector<std::span<const int32_t>> merge;
+        for (std::size_t ch = 0; ch < channels; ch++)
+        {
+            split.push_back(std::span<int32_t>(planar).subspan(ch * frames, frames));
+            merge.push_back(split.back());
+        }
+
+        std::vector<int32_t> output(input.size());
+        Audio::deinterleave<int32_t>(input, split);
+        Audio::interleave<int32_t>(merge, output);
+
+        for (std::size_t frame = 0; frame < frames; frame++)
+            for (std::size_t ch = 0; ch < channels; ch++)
+                ok = ok && split[ch][frame] == input[frame * channels + ch];
+        ok = ok && output == input;
+    }
+
+    // Throughput of the 4 channel split against the plain loop
+    constexpr std::size_t channels = 4;
+    constexpr std::size_t frames = 1 << 18;
+    constexpr int repeats = 50;
+    std::vector<int32_t> input(frames * channels, 1);
+    std::vector<int32_t> planar(frames * channels);
+    std::vector<std::span<int32_t>> split;
+    for (std::size_t ch = 0; ch < channels; ch++)
+        split.push_back(std::span<int32_t>(planar).subspan(ch * frames, frames));
+
+    auto start = std::chrono::steady_clock::now();
+    for (int repeat = 0; repeat < repeats; repeat++)
+        Audio::deinterleave<int32_t>(input, split);
+    auto kernel = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int repeat = 0; repeat < repeats; repeat++)
+    {
+        int32_t *const out[channels] = {split[0].data(), split[1].data(), split[2].data(), split[3].data()};
+        Audio::kernels::deinterleaveScalar(input.data(), frames, channels, out, 0);
+    }
+    auto scalar = std::chrono::steady_clock::now() - start;
+
+    auto rate = [&](auto elapsed)
+    { return repeats * input.size() / std::chrono::duration<double>(elapsed).count() / 1e9; };
+    printf("%s split    %.2f GS/s  scalar %.2f GS/s\n", ok ? "PASS" : "FAIL", rate(kernel), rate(scalar));
+    return ok;
+}
+
+/* 24 bit packing round trips and sign extends from bit 23 */
+static bool pack24Test()
+{
+    std::vector<int32_t> samples(1003);
+    for (std::size_t idx = 0; idx < samples.size(); idx++)
+        samples[idx] = static_cast<int32_t>(idx * 40503U % (1U << 24)) - (1 << 23);
+
+    std::vector<uint8_t> bytes(3 * samples.size());
+    std::vector<int32_t> unpacked(samples.size());
+    Audio::pack24(samples, bytes.data());
+    Audio::unpack24(bytes.data(), unpacked);
+    bool ok = unpacked == samples;
+
+    // DMA words carry garbage above bit 23
+    std::vector<int32_t> words(samples);
+    for (auto &word : words)
+        word = static_cast<int32_t>((static_cast<uint32_t>(word) & 0xFFFFFFU) | 0x5A000000U);
+    Audio::signExtend24(words);
+    ok = ok && words == samples;
+
+    printf("%s pack24\n", ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+/* The sample ring hands out contiguous runs across the wrap and keeps order */
+static bool ringTest()
+{
+    SpscRing<uint32_t> ring(8);
+    auto fill = [](std::span<uint32_t> space, uint32_t first)
+    {
+        for (std::size_t idx = 0; idx < space.size(); idx++)
+            space[idx] = first + static_cast<uint32_t>(idx);
+    };
+    auto holds = [](std::span<const uint32_t> values, uint32_t first, std::size_t count)
+    {
+        bool match = values.size() == count;
+        for (std::size_t idx = 0; match && idx < count; idx++)
+            match = values[idx] == first + idx;
+        return match;
+    };
+
+    // A partial publish leaves the rest of the claim unseen
+    auto space = ring.claim(5);
+    bool ok = space.size() == 5;
+    fill(space, 0);
+    ring.publish(3);
+    ok = ok && holds(ring.peek(), 0, 3);
+    ring.consume(2);
+
+    // Claims stop at the end of the storage, then continue from its start
+    space = ring.claim(10);
+    ok = ok && space.size() == 5;
+    fill(space, 3);
+    ring.publish(5);
+    space = ring.claim(10);
+    ok = ok && space.size() == 2 && space.data() == ring.claim(1).data();
+    fill(space, 8);
+    ring.publish(2);
+    ok = ok && ring.claim(1).empty() && ring.size() == 8;
+
+    // Peeks stop at the wrap too, the rest follows once consumed
+    ok = ok && holds(ring.peek(), 2, 6) && holds(ring.peek(4), 2, 4);
+    ring.consume(6);
+    ok = ok && holds(ring.peek(), 8, 2);
+    ring.consume(2);
+    ok = ok && ring.peek().empty() && ring.empty();
+
+    // Uneven claims and peeks between two threads keep every sample in order
+    constexpr uint32_t count = 1 << 20;
+    SpscRing<uint32_t> shared(64);
+    std::thread producer([&]
+                         {
+        for (uint32_t next = 0, size = 1; next < count; size = size % 23 + 1)
+        {
+            auto claimed = shared.claim(std::min<std::size_t>(size, count - next));
+            if (claimed.empty())
+                std::this_thread::yield();
+            std::size_t published = claimed.size() - claimed.size() / 3;
+            fill(claimed.first(published), next);
+            shared.publish(published);
+            next += static_cast<uint32_t>(published);
+        } });
+
+    bool ordered = true;
+    for (uint32_t next = 0, size = 1; next < count; size = size % 17 + 1)
+    {
+        auto values = shared.peek(size);
+        if (values.empty())
+            std::this_thread::yield();
+        ordered = ordered && holds(values, next, values.size());
+        shared.consume(values.size());
+        next += static_cast<uint32_t>(values.size());
+    }
+    producer.join();
+    ok = ok && ordered;
+
+    printf("%s ring\n", ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+/* The block scan and the bank track step() to rounding */
+static bool leakyTest()
+{
+    constexpr float alpha = 0.999F;
+    constexpr std::size_t samples = 10007;
+    std::vector<float> input(samples);
+    for (std::size_t idx = 0; idx < samples; idx++)
+        input[idx] = 0.3F + 0.5F * std::sin(0.05F * idx) + 0.1F * std::sin(1.3F * idx);
+
+    // Uneven blocks carry the state across calls and leave tails for step()
+    LeakyIntegrator<float> serial(alpha, 1.0F - alpha, 0.0F);
+    LeakyIntegrator<float> scan(alpha, 1.0F - alpha, 0.0F);
+    std::vector<float> removed(samples);
+    float maxDifference = 0;
+    for (std::size_t start = 0, size = 1; start < samples; start += size, size = size * 3 % 97 + 1)
+    {
+        size = std::min(size, samples - start);
+        scan.removeDc(std::span<const float>(input).subspan(start, size), std::span<float>(removed).subspan(start, size));
+        for (std::size_t idx = start; idx < start + size; idx++)
+            maxDifference = std::max(maxDifference, std::fabs(removed[idx] - (input[idx] - serial.step(input[idx]))));
+    }
+    bool ok = maxDifference < 1e-5F && std::fabs(scan.last() - serial.last()) < 1e-5F;
+
+    // Three interleaved channels through two stages against cascaded step(),
+    // the same operations so only contraction into FMA can differ
+    constexpr std::size_t channels = 3;
+    LeakyBank<float, channels, 2> bank(alpha, 1.0F - alpha, 0.0F);
+    std::vector<LeakyIntegrator<float>> first(channels, LeakyIntegrator<float>(alpha, 1.0F - alpha, 0.0F));
+    auto second = first;
+    std::vector<float> frames(input.begin(), input.begin() + samples / channels * channels);
+    std::vector<float> banked(frames.size());
+    bank.removeDc(frames, banked);
+    for (std::size_t idx = 0; idx < frames.size(); idx++)
+    {
+        std::size_t ch = idx % channels;
+        ok = ok && std::fabs(banked[idx] - (frames[idx] - second[ch].step(first[ch].step(frames[idx])))) < 1e-6F;
+    }
+
+    // Throughput of the scan against step() one sample at a time
+    constexpr int repeats = 200;
+    auto start = std::chrono::steady_clock::now();
+    for (int repeat = 0; repeat < repeats; repeat++)
+        scan.removeDc(input, removed);
+    auto block = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int repeat = 0; repeat < repeats; repeat++)
+        for (std::size_t idx = 0; idx < samples; idx++)
+            removed[idx] = input[idx] - serial.step(input[idx]);
+    auto stepped = std::chrono::steady_clock::now() - start;
+
+    auto rate = [&](auto elapsed)
+    { return repeats * samples / std::chrono::duration<double>(elapsed).count() / 1e6; };
+    printf("%s leaky    max difference %g  scan %.0f MS/s  step %.0f MS/s\n", ok ? "PASS" : "FAIL", maxDifference,
+           rate(block), rate(stepped));
+    return ok;
+}
+
+int main()
+{
+    bool ok = kernelTest();
+    ok = fdafTest() && ok;
+    ok = bankTest() && ok;
+#if defined(FILTERTEST_FIXED_POINT)
+    ok = fixedTest() && ok;
+    ok = divideTest() && ok;
+#endif
+    ok = silenceTest() && ok;
+    ok = interleaveTest() && ok;
+    ok = pack24Test() && ok;
+    ok = ringTest() && ok;
+    ok = leakyTest() && ok;
+    return ok ? 0 : 1;
+}
@@ -7,10 +7,28 @@
 
 #include <array>
 #include <algorithm>
+#include <complex>
+#include <concepts>
+#include <type_traits>
+#include <vector>
 #include <ranges>
+#include <span>
+#include <stdexcept>
+
+#include "accumulator.h"
+#include "delayLine.h"
+#include "fft.h"
+#include "lmsKernels.h"
+#include "reciprocal.h"
 
 namespace LMS
 {
+  // Input to the block API: any sized random access range of values T can be
+  // made from, such as a span or a strided channel view over a mapped file
+  template <typename R, typename T>
+  concept SampleRange = std::ranges::random_access_range<R> && std::ranges::sized_range<R> &&
+                        std::constructible_from<T, std::ranges::range_value_t<R>>;
+
   template <typename T, std::size_t Taps, bool Normalised>
   class FSS
   {
@@ -18,18 +36,19 @@ namespace LMS
     T stepSize;
     T epsilon;
     T err;
-    T pow; // May accumulate error with certain data types and ranges
+    Wide<T> pow; // May accumulate error with certain data types and ranges
 
-    std::array<T, Taps> x_hat;
+    DelayLine<T, Taps> x_hat;
     std::array<T, Taps> h_hat;
+    std::array<T, Taps> gradient; // Block LMS tap update accumulated over a block
 
   public:
     FSS(T stepSize) : FSS(stepSize, stepSize / 100) {};
 
-    FSS(T stepSize, T epsilon) : stepSize(stepSize), epsilon(epsilon), pow(epsilon)
+    FSS(T stepSize, T epsilon) : stepSize(stepSize), epsilon(epsilon), pow(0)
     {
-      x_hat.fill(0);
       h_hat.fill(0);
+      gradient.fill(0);
     }
 
     virtual T step(T xNxt, T dNxt)
@@ -39,6 +58,21 @@ namespace LMS
       return err;
     };
 
+    // Filter a block of samples, identical to calling step on each sample in turn
+    template <SampleRange<T> X, SampleRange<T> D>
+    void process(X &&x, D &&d, std::span<T> e)
+    {
+      run<false>(x, d, e, [](T) {});
+    }
+
+    // Block LMS, taps are held for the whole block and updated once at the end.
+    // The step size scales the summed (not averaged) gradient of the block.
+    template <SampleRange<T> X, SampleRange<T> D>
+    void processBlock(X &&x, D &&d, std::span<T> e)
+    {
+      run<true>(x, d, e, [](T) {});
+    }
+
     T last() const
     {
       return err;
@@ -69,55 +103,99 @@ namespace LMS
     friend std::ostream &operator<<(std::ostream &os, const FSS<TT, TTaps, TNormalised> &fss);
 
   protected:
+    template <bool Block, typename X, typename D, typename Adapt>
+    void run(X &&x, D &&d, std::span<T> e, Adapt adapt)
+    {
+      std::size_t length = std::ranges::size(x);
+      if (length != std::ranges::size(d) || length != e.size())
+        throw std::invalid_argument("LMS block sizes do not match");
+
+      auto xIt = std::ranges::begin(x);
+      auto dIt = std::ranges::begin(d);
+      for (std::size_t idx = 0; idx < length; idx++)
+      {
+        T xNxt = static_cast<T>(xIt[idx]);
+        computeNext(xNxt, static_cast<T>(dIt[idx]));
+        if constexpr (Block)
+          accumulateGradient(gradient, stepSize * err);
+        else
+          updateFilter();
+        e[idx] = err;
+        adapt(xNxt);
+      }
+
+      if constexpr (Block)
+      {
+        for (std::size_t idx = 0; idx < Taps; idx++)
+        {
+          h_hat[idx] += gradient[idx];
+          gradient[idx] = 0;
+        }
+      }
+    }
+
     // Compute next sample estimate, error, and return power
     void computeNext(T xNxt, T dNxt)
     {
 
       T est = 0;
+      T xOld = x_hat.push(xNxt);
       if constexpr (Taps > 1)
-        pow -= x_hat[Taps - 1] * x_hat[Taps - 1];
+        pow -= Accumulator<T>::product(xOld, xOld);
 
-      for (std::size_t idx = (Taps - 1); idx > 0; idx--)
+      if constexpr (std::is_same<T, float>::value)
+      {
+        est = kernels::dot(h_hat.data(), x_hat.data(), Taps);
+      }
+      else
       {
-        x_hat[idx] = x_hat[idx - 1];
-        est += h_hat[idx] * x_hat[idx];
+        // Sum at full precision, round to T once
+        Wide<T> sum = 0;
+        for (std::size_t idx = (Taps - 1); idx > 0; idx--)
+          sum += Accumulator<T>::product(h_hat[idx], x_hat[idx]);
+        sum += Accumulator<T>::product(h_hat[0], x_hat[0]);
+        est = static_cast<T>(sum);
       }
-      x_hat[0] = xNxt;
-      est += h_hat[0] * x_hat[0];
 
-      pow += x_hat[0] * x_hat[0];
+      pow += Accumulator<T>::product(x_hat[0], x_hat[0]);
       err = dNxt - est;
     }
 
     void updateFilter()
     {
       // Update filter taps based on error
-      T estimator = stepSize * err;
-      for (std::size_t idx = 0; idx < Taps; idx++)
-      {
-        T tapDelta = estimator * x_hat[idx];
-        if constexpr (Normalised)
-          tapDelta = normalise(tapDelta);
-        h_hat[idx] += tapDelta;
-      }
+      accumulateGradient(h_hat, stepSize * err);
     }
 
-    T normalise(T tapDelta)
+    void accumulateGradient(std::array<T, Taps> &taps, T estimator)
     {
-      if (pow == 0)
+      if constexpr (Normalised)
+        estimator = normalise(estimator);
+
+      if constexpr (std::is_same<T, float>::value)
+      {
+        kernels::accumulate(taps.data(), x_hat.data(), Taps, estimator);
+      }
+      else
       {
-        return tapDelta;
+        for (std::size_t idx = 0; idx < Taps; idx++)
+          taps[idx] += estimator * x_hat[idx];
       }
+    }
 
-      if constexpr (std::is_same<T, float>::value)
+    // stepSize * err / (pow + epsilon), once per sample so the tap update is a
+    // plain multiply-add
+    T normalise(T estimator) const
+    {
+      T scale = divide<T>(estimator, pow + static_cast<Wide<T>>(epsilon));
+
+      if constexpr (std::is_floating_point<T>::value)
       {
-        if (tapDelta != tapDelta) // Check for float NaN
+        if (scale != scale) // Check for float NaN
           return 0;
       }
 
-      tapDelta /= pow;
-
-      return tapDelta;
+      return scale;
     };
   };
 
@@ -146,25 +224,196 @@ namespace LMS
     {
       this->computeNext(xNxt, dNxt);
       this->updateFilter();
+      adaptStepSize(xNxt);
+
+      return err;
+    };
+
+    template <SampleRange<T> X, SampleRange<T> D>
+    void process(X &&x, D &&d, std::span<T> e)
+    {
+      this->template run<false>(x, d, e, [this](T xNxt)
+                                { adaptStepSize(xNxt); });
+    }
 
-      // Update step size
+    // As process, also tracing the step size reached after each sample
+    template <SampleRange<T> X, SampleRange<T> D>
+    void process(X &&x, D &&d, std::span<T> e, std::span<T> steps)
+    {
+      if (steps.size() != e.size())
+        throw std::invalid_argument("LMS step size trace does not match the block");
+
+      std::size_t idx = 0;
+      this->template run<false>(x, d, e, [this, steps, &idx](T xNxt)
+                                { adaptStepSize(xNxt);
+                                  steps[idx++] = stepSize; });
+    }
+
+    // Block LMS, the step size still adapts every sample
+    template <SampleRange<T> X, SampleRange<T> D>
+    void processBlock(X &&x, D &&d, std::span<T> e)
+    {
+      this->template run<true>(x, d, e, [this](T xNxt)
+                               { adaptStepSize(xNxt); });
+    }
+
+    T resetStepSize()
+    {
+      stepSize = intStep;
+      return stepSize;
+    };
+
+    template <typename TT, std::size_t TTaps, bool TNormalised>
+    friend std::ostream &operator<<(std::ostream &os, const VSS<TT, TTaps, TNormalised> &vss);
+
+  protected:
+    void adaptStepSize(T xNxt)
+    {
       T alphaStepSize = alpha * stepSize;
       T gammaStepSize = gamma * err * xNxt;
       stepSize = alphaStepSize + gammaStepSize;
       stepSize = std::max(stepSize, minStep);
       stepSize = std::min(stepSize, maxStep);
+    }
+  };
+
+  // Frequency domain adaptive filter (constrained overlap-save block LMS). Input is
+  // gathered into blocks of Taps samples and each block costs five FFTs of size
+  // 2 * Taps, so the per-sample cost is O(log Taps) rather than O(Taps).
+  // Errors are only known once a block is complete, so step returns the error
+  // of the sample Taps steps earlier. Normalised uses a per-bin power estimate.
+  template <typename T, std::size_t Taps, bool Normalised>
+  class FDAF
+  {
+    static_assert(std::is_floating_point<T>::value, "FDAF requires a floating point type");
+    static_assert((Taps & (Taps - 1)) == 0, "FDAF taps must be a power of two");
 
+    static constexpr std::size_t Bins = 2 * Taps;
+    static constexpr T powerForgetting = T(0.9);
+
+    using Complex = std::complex<T>;
+
+  protected:
+    T stepSize;
+    T epsilon;
+    T err;
+
+    std::size_t fill = 0;
+    std::vector<T> xBlock;    // Current input block, time domain
+    std::vector<T> dBlock;    // Current desired block, time domain
+    std::vector<T> errBlock;  // Errors of the previous block
+    std::vector<T> xPrevious; // Previous input block, the overlap in overlap-save
+
+    std::vector<Complex> X;   // Spectrum of the last two input blocks
+    std::vector<Complex> H;   // Filter taps, frequency domain
+    std::vector<Complex> buf; // Scratch spectrum
+    std::vector<T> power;     // Per-bin input power
+
+    FFT<T, Bins> fft;
+
+  public:
+    FDAF(T stepSize) : FDAF(stepSize, stepSize / 100) {};
+
+    FDAF(T stepSize, T epsilon) : stepSize(stepSize), epsilon(epsilon), err(0),
+                                  xBlock(Taps, 0), dBlock(Taps, 0), errBlock(Taps, 0), xPrevious(Taps, 0),
+                                  X(Bins), H(Bins), buf(Bins), power(Bins, epsilon) {};
+
+    T step(T xNxt, T dNxt)
+    {
+      err = errBlock[fill];
+      xBlock[fill] = xNxt;
+      dBlock[fill] = dNxt;
+      if (++fill == Taps)
+      {
+        updateBlock();
+        fill = 0;
+      }
       return err;
-    };
+    }
 
-    T resetStepSize()
+    // Filter a block of samples, errors lag the input by Taps samples as in step
+    template <SampleRange<T> X, SampleRange<T> D>
+    void process(X &&x, D &&d, std::span<T> e)
+    {
+      std::size_t length = std::ranges::size(x);
+      if (length != std::ranges::size(d) || length != e.size())
+        throw std::invalid_argument("LMS block sizes do not match");
+
+      auto xIt = std::ranges::begin(x);
+      auto dIt = std::ranges::begin(d);
+      for (std::size_t idx = 0; idx < length; idx++)
+        e[idx] = step(static_cast<T>(xIt[idx]), static_cast<T>(dIt[idx]));
+    }
+
+    T last() const
+    {
+      return err;
+    }
+
+    T getStepSize() const
     {
-      stepSize = intStep;
       return stepSize;
-    };
+    }
+
+    static constexpr std::size_t latency()
+    {
+      return Taps;
+    }
 
     template <typename TT, std::size_t TTaps, bool TNormalised>
-    friend std::ostream &operator<<(std::ostream &os, const VSS<TT, TTaps, TNormalised> &vss);
+    friend std::ostream &operator<<(std::ostream &os, const FDAF<TT, TTaps, TNormalised> &fdaf);
+
+  protected:
+    void updateBlock()
+    {
+      auto bins = [](std::vector<Complex> &v)
+      { return std::span<Complex, Bins>(v.data(), Bins); };
+
+      // Spectrum of [previous block, current block]
+      for (std::size_t idx = 0; idx < Taps; idx++)
+      {
+        X[idx] = Complex(xPrevious[idx], 0);
+        X[idx + Taps] = Complex(xBlock[idx], 0);
+      }
+      fft.forward(bins(X));
+      std::copy(xBlock.begin(), xBlock.end(), xPrevious.begin());
+
+      // Output is the last half of the circular convolution
+      for (std::size_t k = 0; k < Bins; k++)
+        buf[k] = multiply(X[k], H[k]);
+      fft.inverse(bins(buf));
+      for (std::size_t idx = 0; idx < Taps; idx++)
+        errBlock[idx] = dBlock[idx] - buf[idx + Taps].real();
+
+      // Error spectrum of [zeros, error block]
+      for (std::size_t idx = 0; idx < Taps; idx++)
+      {
+        buf[idx] = Complex(0, 0);
+        buf[idx + Taps] = Complex(errBlock[idx], 0);
+      }
+      fft.forward(bins(buf));
+
+      // Gradient is the correlation of input and error, scaled per bin
+      for (std::size_t k = 0; k < Bins; k++)
+      {
+        T scale = stepSize;
+        if constexpr (Normalised)
+        {
+          power[k] = powerForgetting * power[k] + (1 - powerForgetting) * std::norm(X[k]);
+          scale /= power[k] + epsilon;
+        }
+        buf[k] = multiply(std::conj(X[k]), buf[k]) * scale;
+      }
+
+      // Constrain the gradient to a causal Taps long filter
+      fft.inverse(bins(buf));
+      for (std::size_t idx = Taps; idx < Bins; idx++)
+        buf[idx] = Complex(0, 0);
+      fft.forward(bins(buf));
+
+      for (std::size_t k = 0; k < Bins; k++)
+        H[k] += buf[k];
+    }
   };
 
   template <typename T, std::size_t Taps, bool Normalised>
@@ -186,4 +435,14 @@ namespace LMS
     os << "maxStep:\t" << vss.maxStep;
     return os;
   };
+
+  template <typename T, std::size_t Taps, bool Normalised>
+  std::ostream &operator<<(std::ostream &os, const FDAF<T, Taps, Normalised> &fdaf)
+  {
+    os << "stepSize :\t" << fdaf.stepSize << "\n";
+    os << "epsilon  :\t" << fdaf.epsilon << "\n";
+    os << "blockSize:\t" << Taps << "\n";
+    os << "err      :\t" << fdaf.err;
+    return os;
+  };
 }
@@ -0,0 +1,189 @@
+/* Copyright (C) 2024-2025 Tom Pacino.  All rights reserved.
+ *
+ * Contact author for permissions t.pacino@unsw.edu.au
+ */
+
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+
+#include "accumulator.h"
+#include "reciprocal.h"
+
+namespace LMS
+{
+  // A bank of independent VSS filters, one per channel, advanced together.
+  // State is stored structure-of-arrays with the channel as the innermost
+  // index, so every per-tap operation is a contiguous loop over channels that
+  // the compiler vectorises. This pays off most when Taps is small.
+  // The delay line is mirrored as in DelayLine and shared by all channels.
+  template <typename T, std::size_t Taps, std::size_t Channels, bool Normalised = true>
+  class Bank
+  {
+    static_assert(Taps > 0 && Channels > 0, "Bank requires at least one tap and one channel");
+
+  protected:
+    T alpha;
+    T gamma;
+    T epsilon;
+    T minStep;
+    T maxStep;
+    T intStep;
+
+    std::size_t head = 0;
+    std::array<T, 2 * Taps * Channels> x_hat; // [slot][channel], mirrored
+    std::array<T, Taps * Channels> h_hat;     // [tap][channel]
+
+    std::array<T, Channels> stepSize;
+    std::array<T, Channels> err;
+    std::array<Wide<T>, Channels> pow;
+
+  public:
+    Bank(T stepSize, T alpha, T gamma) : Bank(stepSize, alpha, gamma, stepSize / 100, stepSize / 100, stepSize * 100) {};
+
+    Bank(T stepSize, T alpha, T gamma, T epsilon, T minStep, T maxStep) : alpha(alpha), gamma(gamma), epsilon(epsilon), minStep(minStep), maxStep(maxStep), intStep(stepSize)
+    {
+      x_hat.fill(0);
+      h_hat.fill(0);
+      this->stepSize.fill(stepSize);
+      err.fill(0);
+      pow.fill(0);
+    }
+
+    // Advance every channel by one sample
+    void step(std::span<const T, Channels> xNxt, std::span<const T, Channels> dNxt, std::span<T, Channels> e)
+    {
+      computeNext(xNxt.data(), dNxt.data());
+      updateFilter();
+      adaptStepSize(xNxt.data());
+      std::copy(err.begin(), err.end(), e.begin());
+    }
+
+    // Filter interleaved frames of Channels samples each, as delivered by the DMA
+    void process(std::span<const T> x, std::span<const T> d, std::span<T> e)
+    {
+      if (x.size() != d.size() || x.size() != e.size() || x.size() % Channels != 0)
+        throw std::invalid_argument("LMS bank block sizes do not match whole frames");
+
+      for (std::size_t frame = 0; frame < x.size(); frame += Channels)
+      {
+        computeNext(x.data() + frame, d.data() + frame);
+        updateFilter();
+        adaptStepSize(x.data() + frame);
+        std::copy(err.begin(), err.end(), e.begin() + frame);
+      }
+    }
+
+    T last(std::size_t channel) const
+    {
+      return err[channel];
+    }
+
+    T getStepSize(std::size_t channel) const
+    {
+      return stepSize[channel];
+    }
+
+    void resetStepSize()
+    {
+      stepSize.fill(intStep);
+    }
+
+    template <typename TT, std::size_t TTaps, std::size_t TChannels, bool TNormalised>
+    friend std::ostream &operator<<(std::ostream &os, const Bank<TT, TTaps, TChannels, TNormalised> &bank);
+
+  protected:
+    T *slot(std::size_t idx)
+    {
+      return x_hat.data() + (head + idx) * Channels;
+    }
+
+    T *tap(std::size_t idx)
+    {
+      return h_hat.data() + idx * Channels;
+    }
+
+    void computeNext(const T *xNxt, const T *dNxt)
+    {
+      head = (head == 0) ? Taps - 1 : head - 1;
+      T *newest = slot(0);
+      T *mirror = slot(Taps);
+
+      for (std::size_t ch = 0; ch < Channels; ch++)
+      {
+        // The slot being overwritten holds the oldest sample
+        if constexpr (Taps > 1)
+          pow[ch] -= Accumulator<T>::product(newest[ch], newest[ch]);
+        newest[ch] = xNxt[ch];
+        mirror[ch] = xNxt[ch];
+        pow[ch] += Accumulator<T>::product(xNxt[ch], xNxt[ch]);
+      }
+
+      // Summed at full precision and rounded to T once
+      std::array<Wide<T>, Channels> est;
+      est.fill(0);
+      for (std::size_t idx = 0; idx < Taps; idx++)
+      {
+        const T *x = slot(idx);
+        const T *h = tap(idx);
+        for (std::size_t ch = 0; ch < Channels; ch++)
+          est[ch] += Accumulator<T>::product(h[ch], x[ch]);
+      }
+
+      for (std::size_t ch = 0; ch < Channels; ch++)
+        err[ch] = dNxt[ch] - static_cast<T>(est[ch]);
+    }
+
+    void updateFilter()
+    {
+      // Step size, error and normalisation folded into one factor per channel
+      std::array<T, Channels> scale;
+      for (std::size_t ch = 0; ch < Channels; ch++)
+      {
+        scale[ch] = stepSize[ch] * err[ch];
+        if constexpr (Normalised)
+        {
+          scale[ch] = divide<T>(scale[ch], pow[ch] + static_cast<Wide<T>>(epsilon));
+          if (scale[ch] != scale[ch]) // Check for float NaN
+            scale[ch] = 0;
+        }
+      }
+
+      for (std::size_t idx = 0; idx < Taps; idx++)
+      {
+        const T *x = slot(idx);
+        T *h = tap(idx);
+        for (std::size_t ch = 0; ch < Channels; ch++)
+          h[ch] += scale[ch] * x[ch];
+      }
+    }
+
+    void adaptStepSize(const T *xNxt)
+    {
+      for (std::size_t ch = 0; ch < Channels; ch++)
+      {
+        T alphaStepSize = alpha * stepSize[ch];
+        T gammaStepSize = gamma * err[ch] * xNxt[ch];
+        stepSize[ch] = alphaStepSize + gammaStepSize;
+        stepSize[ch] = std::max(stepSize[ch], minStep);
+        stepSize[ch] = std::min(stepSize[ch], maxStep);
+      }
+    }
+  };
+
+  template <typename T, std::size_t Taps, std::size_t Channels, bool Normalised>
+  std::ostream &operator<<(std::ostream &os, const Bank<T, Taps, Channels, Normalised> &bank)
+  {
+    os << "channels :\t" << Channels << "\n";
+    os << "epsilon  :\t" << bank.epsilon << "\n";
+    os << "alpha    :\t" << bank.alpha << "\n";
+    os << "gamma    :\t" << bank.gamma << "\n";
+    os << "minstep  :\t" << bank.minStep << "\n";
+    os << "maxStep  :\t" << bank.maxStep;
+    return os;
+  };
+}
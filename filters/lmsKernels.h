@@ -0,0 +1,177 @@
+/* Copyright (C) 2024-2025 Tom Pacino.  All rights reserved.
+ *
+ * Contact author for permissions t.pacino@unsw.edu.au
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+// Define LMS_SCALAR_KERNELS to force the portable kernels on any target
+#if !defined(LMS_SCALAR_KERNELS) && defined(__AVX2__)
+#define LMS_KERNELS_AVX2
+#include <immintrin.h>
+#elif !defined(LMS_SCALAR_KERNELS) && defined(__SSE2__)
+#define LMS_KERNELS_SSE
+#include <emmintrin.h>
+#elif !defined(LMS_SCALAR_KERNELS) && defined(__ARM_NEON)
+#define LMS_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace LMS::kernels
+{
+  // All float kernels share one canonical evaluation order so that every
+  // implementation is bit-identical to the scalar one:
+  //   - element i is accumulated into partial sum (i % Lanes)
+  //   - partials are reduced pairwise, p[j] + p[j + Lanes / 2], down to one
+  //   - the remaining n % Lanes elements are then added in index order
+  // Products are never fused with the add, the filters target builds with
+  // -ffp-contract=off so the compiler cannot fuse them either.
+  // The exception is ARMv7 NEON (the Zynq-7000 Cortex-A9), which always
+  // flushes denormal inputs and results to zero. Its results match the scalar
+  // kernels only while no product or partial sum is denormal, AArch64 NEON
+  // handles denormals and stays bit-identical.
+  constexpr std::size_t Lanes = 16;
+
+  inline float reduce(std::array<float, Lanes> &partial)
+  {
+    for (std::size_t width = Lanes / 2; width > 0; width /= 2)
+      for (std::size_t j = 0; j < width; j++)
+        partial[j] = partial[j] + partial[j + width];
+    return partial[0];
+  }
+
+  inline float dotScalar(const float *h, const float *x, std::size_t n)
+  {
+    std::array<float, Lanes> partial{};
+    std::size_t blocked = n - n % Lanes;
+    for (std::size_t idx = 0; idx < blocked; idx += Lanes)
+      for (std::size_t lane = 0; lane < Lanes; lane++)
+        partial[lane] += h[idx + lane] * x[idx + lane];
+
+    float sum = reduce(partial);
+    for (std::size_t idx = blocked; idx < n; idx++)
+      sum += h[idx] * x[idx];
+    return sum;
+  }
+
+  // h[i] += scale * x[i]
+  inline void accumulateScalar(float *h, const float *x, std::size_t n, float scale)
+  {
+    for (std::size_t idx = 0; idx < n; idx++)
+      h[idx] += scale * x[idx];
+  }
+
+#if defined(LMS_KERNELS_AVX2)
+  inline float dot(const float *h, const float *x, std::size_t n)
+  {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    std::size_t blocked = n - n % Lanes;
+    for (std::size_t idx = 0; idx < blocked; idx += Lanes)
+    {
+      acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(h + idx), _mm256_loadu_ps(x + idx)));
+      acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(h + idx + 8), _mm256_loadu_ps(x + idx + 8)));
+    }
+
+    __m256 sum8 = _mm256_add_ps(acc0, acc1);
+    __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(sum8), _mm256_extractf128_ps(sum8, 1));
+    __m128 sum2 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+    __m128 sum1 = _mm_add_ss(sum2, _mm_shuffle_ps(sum2, sum2, 0x55));
+    float sum = _mm_cvtss_f32(sum1);
+
+    for (std::size_t idx = blocked; idx < n; idx++)
+      sum += h[idx] * x[idx];
+    return sum;
+  }
+
+  inline void accumulate(float *h, const float *x, std::size_t n, float scale)
+  {
+    __m256 s = _mm256_set1_ps(scale);
+    std::size_t blocked = n - n % 8;
+    for (std::size_t idx = 0; idx < blocked; idx += 8)
+      _mm256_storeu_ps(h + idx, _mm256_add_ps(_mm256_loadu_ps(h + idx), _mm256_mul_ps(s, _mm256_loadu_ps(x + idx))));
+    accumulateScalar(h + blocked, x + blocked, n - blocked, scale);
+  }
+#elif defined(LMS_KERNELS_SSE)
+  inline float dot(const float *h, const float *x, std::size_t n)
+  {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps();
+    __m128 acc3 = _mm_setzero_ps();
+    std::size_t blocked = n - n % Lanes;
+    for (std::size_t idx = 0; idx < blocked; idx += Lanes)
+    {
+      acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(h + idx), _mm_loadu_ps(x + idx)));
+      acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(h + idx + 4), _mm_loadu_ps(x + idx + 4)));
+      acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(h + idx + 8), _mm_loadu_ps(x + idx + 8)));
+      acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(h + idx + 12), _mm_loadu_ps(x + idx + 12)));
+    }
+
+    __m128 sum4 = _mm_add_ps(_mm_add_ps(acc0, acc2), _mm_add_ps(acc1, acc3));
+    __m128 sum2 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+    __m128 sum1 = _mm_add_ss(sum2, _mm_shuffle_ps(sum2, sum2, 0x55));
+    float sum = _mm_cvtss_f32(sum1);
+
+    for (std::size_t idx = blocked; idx < n; idx++)
+      sum += h[idx] * x[idx];
+    return sum;
+  }
+
+  inline void accumulate(float *h, const float *x, std::size_t n, float scale)
+  {
+    __m128 s = _mm_set1_ps(scale);
+    std::size_t blocked = n - n % 4;
+    for (std::size_t idx = 0; idx < blocked; idx += 4)
+      _mm_storeu_ps(h + idx, _mm_add_ps(_mm_loadu_ps(h + idx), _mm_mul_ps(s, _mm_loadu_ps(x + idx))));
+    accumulateScalar(h + blocked, x + blocked, n - blocked, scale);
+  }
+#elif defined(LMS_KERNELS_NEON)
+  inline float dot(const float *h, const float *x, std::size_t n)
+  {
+    float32x4_t acc0 = vdupq_n_f32(0.0F);
+    float32x4_t acc1 = vdupq_n_f32(0.0F);
+    float32x4_t acc2 = vdupq_n_f32(0.0F);
+    float32x4_t acc3 = vdupq_n_f32(0.0F);
+    std::size_t blocked = n - n % Lanes;
+    for (std::size_t idx = 0; idx < blocked; idx += Lanes)
+    {
+      // vmul + vadd rather than vmla/vfma to keep the scalar rounding
+      acc0 = vaddq_f32(acc0, vmulq_f32(vld1q_f32(h + idx), vld1q_f32(x + idx)));
+      acc1 = vaddq_f32(acc1, vmulq_f32(vld1q_f32(h + idx + 4), vld1q_f32(x + idx + 4)));
+      acc2 = vaddq_f32(acc2, vmulq_f32(vld1q_f32(h + idx + 8), vld1q_f32(x + idx + 8)));
+      acc3 = vaddq_f32(acc3, vmulq_f32(vld1q_f32(h + idx + 12), vld1q_f32(x + idx + 12)));
+    }
+
+    float32x4_t sum4 = vaddq_f32(vaddq_f32(acc0, acc2), vaddq_f32(acc1, acc3));
+    float32x2_t sum2 = vadd_f32(vget_low_f32(sum4), vget_high_f32(sum4));
+    float sum = vget_lane_f32(vpadd_f32(sum2, sum2), 0);
+
+    for (std::size_t idx = blocked; idx < n; idx++)
+      sum += h[idx] * x[idx];
+    return sum;
+  }
+
+  inline void accumulate(float *h, const float *x, std::size_t n, float scale)
+  {
+    float32x4_t s = vdupq_n_f32(scale);
+    std::size_t blocked = n - n % 4;
+    for (std::size_t idx = 0; idx < blocked; idx += 4)
+      vst1q_f32(h + idx, vaddq_f32(vld1q_f32(h + idx), vmulq_f32(s, vld1q_f32(x + idx))));
+    accumulateScalar(h + blocked, x + blocked, n - blocked, scale);
+  }
+#else
+  inline float dot(const float *h, const float *x, std::size_t n)
+  {
+    return dotScalar(h, x, n);
+  }
+
+  inline void accumulate(float *h, const float *x, std::size_t n, float scale)
+  {
+    accumulateScalar(h, x, n, scale);
+  }
+#endif
+}
@@ -0,0 +1,119 @@
+/* Copyright (C) 2024-2025 Tom Pacino.  All rights reserved.
+ *
+ * Contact author for permissions t.pacino@unsw.edu.au
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+
+#include "accumulator.h"
+
+namespace LMS
+{
+  // Seeds for 1 / m, m in [0.5, 1), indexed by the 5 bits below the leading
+  // one of m. Each seed is the reciprocal of its interval midpoint in Q30.
+  constexpr std::size_t reciprocalSeedBits = 5;
+
+  constexpr std::array<std::uint32_t, 1U << reciprocalSeedBits> reciprocalSeeds = []
+  {
+    std::array<std::uint32_t, 1U << reciprocalSeedBits> seeds{};
+    constexpr std::uint64_t intervals = 1U << reciprocalSeedBits;
+    for (std::uint64_t idx = 0; idx < intervals; idx++)
+    {
+      // Midpoint of [0.5 + idx / 2^(bits + 1), 0.5 + (idx + 1) / 2^(bits + 1))
+      std::uint64_t midpoint = 2 * intervals + 2 * idx + 1; // In units of 1 / 2^(bits + 2)
+      seeds[idx] = static_cast<std::uint32_t>((std::uint64_t{1} << (30 + reciprocalSeedBits + 2)) / midpoint);
+    }
+    return seeds;
+  }();
+
+  // 1 / m for a Q31 mantissa m in [2^30, 2^31), returned in Q30. The table seed
+  // is good to about 6 bits and each Newton step r = r * (2 - m * r) doubles that.
+  inline std::uint32_t reciprocalMantissa(std::uint32_t mantissa)
+  {
+    std::uint64_t r = reciprocalSeeds[(mantissa >> (30 - reciprocalSeedBits)) & ((1U << reciprocalSeedBits) - 1)];
+    for (int iteration = 0; iteration < 2; iteration++)
+    {
+      std::uint64_t mr = (mantissa * r) >> 31; // Q30, close to 1
+      r = (r * ((std::uint64_t{2} << 30) - mr)) >> 30;
+    }
+    return static_cast<std::uint32_t>(r);
+  }
+
+  // Rep and exponent of a cnl scaled_integer, value = rep * 2^exponent
+  template <typename T>
+  struct FixedPoint;
+
+  template <typename Rep, int Exponent>
+  struct FixedPoint<cnl::scaled_integer<Rep, cnl::power<Exponent, 2>>>
+  {
+    using rep = Rep;
+    static constexpr int exponent = Exponent;
+  };
+
+  // numerator / denominator on fixed point reps, denominator > 0 at
+  // denominatorExponent, the quotient at the numerator's exponent. The
+  // leading one of the denominator gives its Q31 mantissa and scale, so the
+  // quotient is a multiply by the reciprocal and a shift. Rounds toward
+  // negative infinity and saturates to 64 bits.
+  inline std::int64_t divideRep(std::int32_t numerator, std::uint64_t denominator, int denominatorExponent)
+  {
+    int lead = std::countl_zero(denominator);
+    int msb = 63 - lead;
+    auto mantissa = static_cast<std::uint32_t>((denominator << lead) >> 33);
+
+    // denominator = mantissa * 2^(msb - 30), so the Q30 reciprocal is scaled back by 2^-(31 + msb)
+    std::int64_t quotient = std::int64_t{numerator} * reciprocalMantissa(mantissa);
+    int shift = 31 + msb + denominatorExponent;
+    if (shift >= 0)
+      return quotient >> std::min(shift, 63);
+
+    constexpr std::int64_t limit = std::numeric_limits<std::int64_t>::max();
+    int left = -shift;
+    if (left >= 63 || quotient > (limit >> left) || quotient < -(limit >> left))
+      return quotient < 0 ? -limit : limit;
+    return quotient * (std::int64_t{1} << left);
+  }
+
+  // numerator / denominator for the once per sample normalisation of NLMS.
+  // Floating point divides, integers use one integer division, and fixed point
+  // types multiply by a table and Newton reciprocal so there is no divide at all,
+  // integer or floating.
+  // A non-positive denominator leaves the numerator unnormalised.
+  template <typename T>
+  T divide(T numerator, Wide<T> denominator)
+  {
+    if constexpr (std::floating_point<T>)
+    {
+      if (denominator <= 0)
+        return numerator;
+      return numerator / denominator;
+    }
+    else if constexpr (std::integral<T>)
+    {
+      if (denominator <= 0)
+        return numerator;
+      return static_cast<T>(static_cast<Wide<T>>(numerator) / denominator);
+    }
+    else
+    {
+      using Rep = typename FixedPoint<T>::rep;
+      static_assert(sizeof(Rep) <= sizeof(std::int32_t), "Fixed point divide supports reps of up to 32 bits");
+
+      auto denominatorRep = cnl::to_rep<Wide<T>>{}(denominator);
+      if (denominatorRep <= 0)
+        return numerator;
+
+      std::int64_t quotient = divideRep(static_cast<std::int32_t>(cnl::to_rep<T>{}(numerator)), static_cast<std::uint64_t>(denominatorRep),
+                                        FixedPoint<Wide<T>>::exponent);
+      quotient = std::clamp<std::int64_t>(quotient, std::numeric_limits<Rep>::min(), std::numeric_limits<Rep>::max());
+      return cnl::from_rep<T, Rep>{}(static_cast<Rep>(quotient));
+    }
+  }
+}
@@ -0,0 +1,207 @@
+/* Copyright (C) 2024-2025 Tom Pacino.  All rights reserved.
+ *
+ * Contact author for permissions t.pacino@unsw.edu.au
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+constexpr std::size_t CACHE_LINE_BYTES = 64;
+
+// Lock-free single-producer single-consumer queue of fixed power-of-two capacity.
+// Producer and consumer indices live on separate cache lines, and each side keeps
+// a cached copy of the other's index so it only touches the shared line when the
+// queue looks full or empty.
+template <typename T, std::size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+    static constexpr std::size_t mask = Capacity - 1;
+
+    // Consumer side
+    alignas(CACHE_LINE_BYTES) std::atomic<std::size_t> head{0};
+    std::size_t cachedTail = 0;
+
+    // Producer side
+    alignas(CACHE_LINE_BYTES) std::atomic<std::size_t> tail{0};
+    std::size_t cachedHead = 0;
+
+    alignas(CACHE_LINE_BYTES) std::array<T, Capacity> slots;
+
+public:
+    // Producer only, returns false when full
+    bool push(const T &value)
+    {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead == Capacity)
+        {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead == Capacity)
+                return false;
+        }
+
+        slots[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only, returns false when empty
+    bool pop(T &value)
+    {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail)
+        {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail)
+                return false;
+        }
+
+        value = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called concurrently
+    std::size_t size() const
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    static constexpr std::size_t capacity()
+    {
+        return Capacity;
+    }
+};
+
+// Lock-free single-producer single-consumer ring of samples, for moving runs of
+// frames between threads without a copy per element. The producer claims
+// contiguous space, fills it and publishes it; the consumer peeks at what is
+// published and consumes it when done. Capacity is a power of two chosen at
+// construction, indices are laid out as in SpscQueue.
+template <typename T>
+class SpscRing
+{
+    // Consumer side
+    alignas(CACHE_LINE_BYTES) std::atomic<std::size_t> head{0};
+    std::size_t cachedTail = 0;
+
+    // Producer side
+    alignas(CACHE_LINE_BYTES) std::atomic<std::size_t> tail{0};
+    std::size_t cachedHead = 0;
+
+    alignas(CACHE_LINE_BYTES) std::size_t mask;
+    std::vector<T> slots;
+
+public:
+    explicit SpscRing(std::size_t capacity) : mask(capacity - 1), slots(capacity)
+    {
+        if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+            throw std::invalid_argument("SpscRing capacity must be a power of two");
+    }
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    // Producer only, contiguous free space of at most count elements. Shorter
+    // when the ring is nearly full or the space wraps, empty when full.
+    std::span<T> claim(std::size_t count)
+    {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if (slots.size() - (t - cachedHead) < count)
+            cachedHead = head.load(std::memory_order_acquire);
+
+        std::size_t space = slots.size() - (t - cachedHead);
+        std::size_t offset = t & mask;
+        return std::span<T>(slots).subspan(offset, std::min({count, space, slots.size() - offset}));
+    }
+
+    // Producer only, makes the first count claimed elements visible
+    void publish(std::size_t count)
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    // Producer only, copies as much of values as fits, returns how many
+    std::size_t write(std::span<const T> values)
+    {
+        std::size_t written = 0;
+        while (written < values.size())
+        {
+            std::span<T> space = claim(values.size() - written);
+            if (space.empty())
+                break;
+            std::copy_n(values.begin() + written, space.size(), space.begin());
+            publish(space.size());
+            written += space.size();
+        }
+        return written;
+    }
+
+    // Producer only, false when full
+    bool push(const T &value)
+    {
+        std::span<T> space = claim(1);
+        if (space.empty())
+            return false;
+        space[0] = value;
+        publish(1);
+        return true;
+    }
+
+    // Consumer only, false when empty
+    bool pop(T &value)
+    {
+        std::span<const T> element = peek(1);
+        if (element.empty())
+            return false;
+        value = element[0];
+        consume(1);
+        return true;
+    }
+
+    // Consumer only, contiguous published elements, at most count of them
+    std::span<const T> peek(std::size_t count = SIZE_MAX)
+    {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (cachedTail - h < std::min(count, slots.size()))
+            cachedTail = tail.load(std::memory_order_acquire);
+
+        std::size_t offset = h & mask;
+        return std::span<const T>(slots).subspan(offset, std::min({count, cachedTail - h, slots.size() - offset}));
+    }
+
+    // Consumer only, frees the first count peeked elements
+    void consume(std::size_t count)
+    {
+        head.store(head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    // Approximate when called concurrently
+    std::size_t size() const
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    std::size_t capacity() const
+    {
+        return slots.size();
+    }
+};
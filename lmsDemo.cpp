@@ -2,14 +2,18 @@
 #include <ranges>
 #include <cstdint>
 #include <numeric>
+#include <string>
+#include <vector>
 
-#include "AudioFile.h"
 #include "cnl/all.h"
 #include "gcem.hpp"
-#include "gsl/gsl_statistics.h"
 
 #include "filters/lms.h"
 #include "filters/leakyIntegrator.h"
+#include "filters/channelPipeline.h"
+#include "filters/correlation.h"
+#include "mappedWav.h"
+#include "wavWriter.h"
 
 using cnl::neg_inf_rounding_tag;
 using cnl::power;
@@ -26,14 +30,107 @@ using T_LEAKY = float;
 // using T_VNLMS = static_integer<16, neg_inf_rounding_tag, saturated_overflow_tag, int16_t>;
 // using T_LEAKY = static_integer<24, neg_inf_rounding_tag, saturated_overflow_tag, int32_t>;
 
-int main()
+// Reference channel lookahead?
+constexpr std::size_t filterTaps = 1U;
+constexpr std::size_t lookahead = (filterTaps == 1U) ? 0U : filterTaps / 2;
+
+// Account for external gain control on LRB (normalise close to (1, -1)
+constexpr float myScalingFactor = 1.0F;
+
+// Inputs are mapped and read in place, outputs are streamed a block at a time
+constexpr std::size_t blockLength = 4096U;
+
+// One block of one channel. Inputs are read straight from the mapped files
+struct BlockJob
 {
-    // Reference channel lookahead?
-    constexpr std::size_t filterTaps = 1U;
-    constexpr std::size_t lookahead = (filterTaps == 1U) ? 0U : filterTaps / 2;
+    std::size_t channel;
+    std::size_t blockStart;
+    std::size_t blockSize;
+
+    std::vector<float> refL = std::vector<float>(blockLength);
+    std::vector<float> optL = std::vector<float>(blockLength);
+    std::vector<float> err = std::vector<float>(blockLength);
+    std::vector<float> stp = std::vector<float>(blockLength);
+    std::vector<float> anc = std::vector<float>(blockLength);
+};
+
+// DC removal and VSS NLMS for one channel, run by a ChannelPipeline worker
+struct ChannelChain
+{
+    const Audio::MappedWav *ref;
+    const Audio::MappedWav *opt;
+    LeakyIntegrator<T_LEAKY> leakyRef;
+    LeakyIntegrator<T_LEAKY> leakyOpt;
+    LMS::VSS<T_VNLMS, filterTaps, true> filter;
+
+    std::vector<T_VNLMS> refBlock = std::vector<T_VNLMS>(blockLength);
+    std::vector<T_VNLMS> optBlock = std::vector<T_VNLMS>(blockLength);
+    std::vector<T_VNLMS> errBlock = std::vector<T_VNLMS>(blockLength);
+    std::vector<T_VNLMS> stpBlock = std::vector<T_VNLMS>(blockLength);
+
+    void operator()(BlockJob &job)
+    {
+        ref->visitChannel(job.channel, [&](auto refView)
+                          { opt->visitChannel(job.channel, [&](auto optView)
+                                              { filterBlock(job, refView.subview(job.blockStart + lookahead, job.blockSize),
+                                                            optView.subview(job.blockStart, job.blockSize)); }); });
+    }
 
-    // Account for external gain control on LRB (normalise close to (1, -1)
-    constexpr float myScalingFactor = 1.0F;
+    template <typename RefView, typename OptView>
+    void filterBlock(BlockJob &job, RefView refView, OptView optView)
+    {
+        for (std::size_t blockIdx = 0; blockIdx < job.blockSize; blockIdx++)
+        {
+            auto refFlt = refView[blockIdx] * myScalingFactor;
+            auto optFlt = optView[blockIdx] * myScalingFactor;
+
+            // Convert to fixed point (32 fraction bits (s1:31))
+            T_LEAKY ref24 = static_cast<T_LEAKY>(refFlt);
+            T_LEAKY opt24 = static_cast<T_LEAKY>(optFlt);
+            T_LEAKY ref24new = leakyRef.step(ref24);
+            T_LEAKY opt24new = leakyOpt.step(opt24);
+
+            job.refL[blockIdx] = float{ref24new} / myScalingFactor;
+            job.optL[blockIdx] = float{opt24new} / myScalingFactor;
+
+            // Subtract average
+            ref24 = ref24 - ref24new;
+            opt24 = opt24 - opt24new;
+            // Skip integration
+            // ref24 = ref24;
+            // opt24 = opt24;
+
+            // Convert to 16 bit fixed point for VLMS filter. Adjust scale factor
+            ref24 = ref24 * myScalingFactor;
+            opt24 = opt24 * myScalingFactor;
+            refFlt = float{ref24};
+            optFlt = float{opt24};
+            refBlock[blockIdx] = static_cast<T_VNLMS>(refFlt);
+            optBlock[blockIdx] = static_cast<T_VNLMS>(optFlt);
+        }
+
+        auto refSpan = std::span<const T_VNLMS>(refBlock).first(job.blockSize);
+        auto optSpan = std::span<const T_VNLMS>(optBlock).first(job.blockSize);
+        auto errSpan = std::span<T_VNLMS>(errBlock).first(job.blockSize);
+        auto stpSpan = std::span<T_VNLMS>(stpBlock).first(job.blockSize);
+        filter.process(optSpan, refSpan, errSpan, stpSpan);
+
+        for (std::size_t blockIdx = 0; blockIdx < job.blockSize; blockIdx++)
+        {
+            T_VNLMS err16 = errSpan[blockIdx];
+            T_VNLMS css16 = stpSpan[blockIdx];
+            T_VNLMS anc16 = optSpan[blockIdx] - err16;
+
+            // Convert back to float to store in WAV
+            job.anc[blockIdx] = float{anc16} / myScalingFactor;
+            job.err[blockIdx] = float{err16} / myScalingFactor;
+            job.stp[blockIdx] = float{css16} / myScalingFactor;
+        }
+    }
+};
+
+int main(int argc, char *argv[])
+{
 
     // Leaky integrators
     constexpr float alphaLeakyF = 0.999F;
@@ -50,7 +147,6 @@ int main()
     constexpr auto initLeakyFF = float{initLeaky};
 
     LeakyIntegrator leakyRef = LeakyIntegrator<T_LEAKY>(alphaLeaky, minusalphaLeaky, initLeaky);
-    LeakyIntegrator leakyOpt = LeakyIntegrator<T_LEAKY>(alphaLeaky, minusalphaLeaky, initLeaky);
 
     std::cout << "leaky integrator\n"
               << leakyRef << "\n";
@@ -82,117 +178,125 @@ int main()
     std::cout << "lms filter\n"
               << myFilter << "\n";
 
-    AudioFile<float> ref;
-    AudioFile<float> opt;
-
-    AudioFile<float> refL;
-    AudioFile<float> optL;
-
-    AudioFile<float> err;
-    AudioFile<float> stp;
-    AudioFile<float> anc;
-
-    // ref.load("temp/i311_ref_data_dt_32.wav");
-    // opt.load("temp/i311_opt_data_dt_32.wav");
-    // ref.load("temp/i311_ref_data_ds_100.wav");
-    // opt.load("temp/i311_opt_data_ds_100.wav");
-
     // Downsample
-    ref.load("temp/i311_ref_data_ds_100.wav");
-    opt.load("temp/i311_opt_data_ds_100.wav");
-
-    // err.load("temp/error_temp_ds_100.wav");
-    // stp.load("temp/step_temp_ds_100.wav");
-    // anc.load("temp/anc_temp_ds_100.wav");
+    std::string refPath = "temp/i311_ref_data_ds_100.wav";
+    std::string optPath = "temp/i311_opt_data_ds_100.wav";
 
+    // "temp/i311_ref_data_dt_32.wav", "temp/i311_opt_data_dt_32.wav"
     // Generated
-    // ref.load("temp/i311_ref_data.wav");
-    // opt.load("temp/i311_opt_data.wav");
-
+    // "temp/i311_ref_data.wav", "temp/i311_opt_data.wav"
     // Big Dataset
-    // ref.load("temp/ADC_CONCAT_1.wav");
-    // opt.load("temp/ADC_CONCAT_2.wav");
-
-    refL.load("temp/refL.wav");
-    optL.load("temp/optL.wav");
-
-    err.load("temp/err.wav");
-    stp.load("temp/stp.wav");
-    anc.load("temp/anc.wav");
-
-    ref.printSummary();
-
-    int channel = 0;
-    int numSamples = ref.getNumSamplesPerChannel() - lookahead;
+    // "temp/ADC_CONCAT_1.wav", "temp/ADC_CONCAT_2.wav"
+    if (argc == 3)
+    {
+        refPath = argv[1];
+        optPath = argv[2];
+    }
 
-    double *optCor = new double[numSamples];
-    double *refCor = new double[numSamples];
-    double *ancCor = new double[numSamples];
+    // Mapping only parses the headers, samples are paged in as the workers reach them
+    Audio::MappedWav ref(refPath);
+    Audio::MappedWav opt(optPath);
+    ref.adviseSequential();
+    opt.adviseSequential();
+
+    std::size_t refChannels = ref.format().channels;
+    std::size_t optChannels = opt.format().channels;
+    std::size_t numChannels = std::min(refChannels, optChannels);
+
+    std::cout << refPath << "\n"
+              << "channels     :\t" << refChannels << "\n"
+              << "sample rate  :\t" << ref.format().sampleRate << "\n"
+              << "bit depth    :\t" << ref.format().bitDepth << "\n"
+              << "frames       :\t" << ref.frames() << "\n";
+
+    // Outputs are float so the step size trace keeps its precision
+    Audio::WavFormat outFormat{static_cast<uint16_t>(numChannels), ref.format().sampleRate, 32, Audio::SampleEncoding::FLOAT};
+    Audio::WavWriter refL("temp/refL.wav", outFormat, blockLength);
+    Audio::WavWriter optL("temp/optL.wav", outFormat, blockLength);
+
+    Audio::WavWriter err("temp/err.wav", outFormat, blockLength);
+    Audio::WavWriter stp("temp/stp.wav", outFormat, blockLength);
+    Audio::WavWriter anc("temp/anc.wav", outFormat, blockLength);
+
+    // The reference leads the optrode, its first lookahead samples have no partner
+    std::size_t numSamples = std::min<uint64_t>(ref.frames() - std::min<uint64_t>(lookahead, ref.frames()), opt.frames());
+
+    // Correlation is traced for the first channel only
+    Correlation optAncCor;
+    Correlation refAncCor;
+    Correlation optRefCor;
+
+    // One filter chain per channel, spread over the available cores
+    std::vector<ChannelChain> chains;
+    for (std::size_t channel = 0; channel < numChannels; channel++)
+        chains.push_back(ChannelChain{&ref,
+                                      &opt,
+                                      LeakyIntegrator<T_LEAKY>(alphaLeaky, minusalphaLeaky, initLeaky),
+                                      LeakyIntegrator<T_LEAKY>(alphaLeaky, minusalphaLeaky, initLeaky),
+                                      myFilter});
+
+    std::size_t workers = std::min<std::size_t>(numChannels, std::max(1U, std::thread::hardware_concurrency()));
+    ChannelPipeline<BlockJob, ChannelChain> pipeline(std::move(chains), workers);
+    std::cout << "filtering " << numChannels << " channels on " << workers << " workers\n";
+
+    std::vector<float> outFrames(blockLength * numChannels);
+    std::vector<BlockJob> jobs(numChannels);
+
+    auto writeChannels = [&](Audio::WavWriter &writer, std::size_t blockSize, auto member)
+    {
+        for (std::size_t channel = 0; channel < numChannels; channel++)
+            for (std::size_t blockIdx = 0; blockIdx < blockSize; blockIdx++)
+                outFrames[blockIdx * numChannels + channel] = (jobs[channel].*member)[blockIdx];
+        writer.write(std::span<const float>(outFrames).first(blockSize * numChannels));
+    };
 
-    for (std::size_t idxOpt = 0; idxOpt < numSamples; idxOpt++)
+    for (std::size_t blockStart = 0; blockStart < numSamples; blockStart += blockLength)
     {
-        std::size_t idxRef = idxOpt + lookahead;
-
-        auto refFlt = ref.samples[channel][idxRef] * myScalingFactor;
-        auto optFlt = opt.samples[channel][idxOpt] * myScalingFactor;
-
-        refCor[idxRef] = static_cast<double>(refFlt);
-        optCor[idxOpt] = static_cast<double>(optFlt);
-
-        // Convert to fixed point (32 fraction bits (s1:31))
-        T_LEAKY ref24 = static_cast<T_LEAKY>(refFlt);
-        T_LEAKY opt24 = static_cast<T_LEAKY>(optFlt);
-        T_LEAKY ref24new = leakyRef.step(ref24);
-        T_LEAKY opt24new = leakyOpt.step(opt24);
-
-        refL.samples[channel][idxRef] = float{ref24new} / myScalingFactor;
-        optL.samples[channel][idxOpt] = float{opt24new} / myScalingFactor;
-
-        // Subtract average
-        ref24 = ref24 - ref24new;
-        opt24 = opt24 - opt24new;
-        // Skip integration
-        // ref24 = ref24;
-        // opt24 = opt24;
-
-        // Convert to 16 bit fixed point for VLMS filter. Adjust scale factor
-        ref24 = ref24 * myScalingFactor;
-        opt24 = opt24 * myScalingFactor;
-        refFlt = float{ref24};
-        optFlt = float{opt24};
-        T_VNLMS ref16 = static_cast<T_VNLMS>(refFlt);
-        T_VNLMS opt16 = static_cast<T_VNLMS>(optFlt);
-        T_VNLMS err16 = myFilter.step(opt16, ref16);
-        T_VNLMS css16 = myFilter.getStepSize();
-        T_VNLMS anc16 = opt16 - err16;
-
-        // Convert back to float to store in WAV
-        anc.samples[channel][idxOpt] = float{anc16} / myScalingFactor;
-        err.samples[channel][idxOpt] = float{err16} / myScalingFactor;
-        stp.samples[channel][idxOpt] = float{css16} / myScalingFactor;
-
-        ancCor[idxOpt] = static_cast<double>(float{anc16});
+        std::size_t blockSize = std::min(blockLength, numSamples - blockStart);
+        for (std::size_t channel = 0; channel < numChannels; channel++)
+        {
+            BlockJob &job = jobs[channel];
+            job.channel = channel;
+            job.blockStart = blockStart;
+            job.blockSize = blockSize;
+            // A worker holding QueueDepth jobs refuses more until some are collected
+            while (!pipeline.submit(&job))
+                pipeline.collect([](BlockJob &) {});
+        }
+        pipeline.drain([](BlockJob &) {});
+
+        auto ancBlock = std::span<const float>(jobs[0].anc).first(blockSize);
+        ref.visitChannel(0, [&](auto refView)
+                         { opt.visitChannel(0, [&](auto optView)
+                                            {
+                                                auto refBlock = refView.subview(blockStart + lookahead, blockSize);
+                                                auto optBlock = optView.subview(blockStart, blockSize);
+                                                optAncCor.add(optBlock, ancBlock);
+                                                refAncCor.add(refBlock, ancBlock);
+                                                optRefCor.add(optBlock, refBlock); }); });
+
+        writeChannels(refL, blockSize, &BlockJob::refL);
+        writeChannels(optL, blockSize, &BlockJob::optL);
+        writeChannels(err, blockSize, &BlockJob::err);
+        writeChannels(stp, blockSize, &BlockJob::stp);
+        writeChannels(anc, blockSize, &BlockJob::anc);
     }
 
-    refL.save("temp/refL.wav");
-    optL.save("temp/optL.wav");
+    refL.close();
+    optL.close();
 
-    err.save("temp/err.wav");
-    stp.save("temp/stp.wav");
-    anc.save("temp/anc.wav");
+    err.close();
+    stp.close();
+    anc.close();
 
     std::cout << "Pearson correlation OPT & ANC:\n"
-              << gsl_stats_correlation(optCor, 1, ancCor, 1, numSamples) << "\n";
+              << optAncCor.value() << "\n";
 
     std::cout << "Pearson correlation REF & ANC:\n"
-              << gsl_stats_correlation(refCor, 1, ancCor, 1, numSamples) << "\n";
+              << refAncCor.value() << "\n";
 
     std::cout << "Pearson correlation OPT & REF:\n"
-              << gsl_stats_correlation(optCor, 1, refCor, 1, numSamples) << "\n";
-
-    delete[] optCor;
-    delete[] refCor;
-    delete[] ancCor;
+              << optRefCor.value() << "\n";
 
     return 0;
 }
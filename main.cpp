@@ -7,55 +7,25 @@
 #include <iomanip>
 #include <sstream>
 #include <cstdint>
+#include <algorithm>
+#include <vector>
 
 #include <boost/log/trivial.hpp>
 
-#include "AudioFile.h"
+#include "ancstage.h"
+#include "asyncwriter.h"
 #include "board.h"
-#include "datawriter.h"
+#include "captureengine.h"
 #include "ui.h"
 #include "config.h"
 
 using namespace mn::CppLinuxSerial;
 
-struct Recording
-{
-    std::string name;
-    std::size_t file;
-    std::size_t bytesPerSample;
-    std::size_t samplesPerFile;
-    std::size_t recordedSamples;
-
-    Recording(std::string name, std::size_t bytesPerSample, std::size_t samplesPerFile) : name(name), file(0), bytesPerSample(bytesPerSample), samplesPerFile(samplesPerFile), recordedSamples(0) {};
-
-    std::string filename() const
-    {
-        return name + '_' + std::to_string(file) + ".wav";
-    }
-
-    std::size_t total() const
-    {
-        return bytesPerSample * (file * samplesPerFile + recordedSamples);
-    };
-
-    std::string to_str() const
-    {
-        std::stringstream ss;
-        ss << name << " - " << bytesPerSample << " bytes per sample - " << samplesPerFile << " samples per file";
-        return ss.str();
-    }
-};
-
-std::ostream &operator<<(std::ostream &os, Recording &r)
-{
-    os << "Audio file: "
-       << r.filename()
-       << "\tSamples this file: "
-       << r.recordedSamples
-       << "\tTotal size in bytes: "
-       << r.total();
-    return os;
-}
+static_assert(WRITER_POOL_BYTES / transfer_block_bytes >= 2 && WRITER_POOL_BYTES / transfer_block_bytes <= MAX_POOL_BLOCKS,
+              "The writer pool must hold between 2 and MAX_POOL_BLOCKS DMA blocks");
+static_assert(ANC_WRITER_POOL_BYTES / (ANC_WRITER_BLOCK_SAMPLES * sizeof(int32_t)) >= 2 &&
+                  ANC_WRITER_POOL_BYTES / (ANC_WRITER_BLOCK_SAMPLES * sizeof(int32_t)) <= MAX_POOL_BLOCKS,
+              "The cancelled writer pool must hold between 2 and MAX_POOL_BLOCKS blocks");
 
 volatile std::sig_atomic_t recordingStopSignal = 0;
 
@@ -68,20 +38,6 @@ void handler(int signal)
     }
 }
 
-template <typename T>
-void initialiseAudioFile(AudioFile<T> &af, typename AudioFile<T>::AudioBuffer &ab, Recording &r)
-{
-    af.setNumChannels(TOTAL_CHANNELS);
-    af.setSampleRate(SAMPLE_RATE);
-    af.setBitDepth(BIT_DEPTH);
-
-    af.setAudioBuffer(ab);
-    af.save(r.filename(), AudioFileFormat::Wave);
-
-    BOOST_LOG_TRIVIAL(debug)
-        << "init audiofile " << r.filename();
-}
-
 int main()
 {
     std::ostringstream logStream;
@@ -91,7 +47,8 @@ int main()
               << "\n\tmem_bytes                     " << MEM_BYTES
               << "\n\tbytes_per_sample              " << BYTES_PER_SAMPLE
               << "\n\tsamples_per_file              " << SAMPLES_PER_FILE
-              << "\n\trecord_file_interval          " << RECORD_FILE_INTERVAL;
+              << "\n\trecord_file_interval          " << RECORD_FILE_INTERVAL
+              << "\n\trecord_anc                    " << RECORD_ANC;
 
     BOOST_LOG_TRIVIAL(info) << logStream.str();
 
@@ -103,22 +60,44 @@ int main()
     oss << std::put_time(&now_tm, "%Y-%m-%d_%H-%M-%S");
     std::string name = FILENAME_ANC + '_' + oss.str();
 
-    Recording r(name, BYTES_PER_SAMPLE, SAMPLES_PER_FILE);
-
-    // prep audio buffer
-    constexpr std::size_t BUFFER_LENGTH = SAMPLE_RATE;
-    AudioFile<uint32_t>::AudioBuffer audioBuffer;
-    audioBuffer.resize(TOTAL_CHANNELS);
-    std::ranges::for_each(audioBuffer, [&BUFFER_LENGTH](auto &b)
-                          { b.reserve(BUFFER_LENGTH); });
-
-    // prep audio file
-    AudioFile<uint32_t> audioFile;
-    initialiseAudioFile(audioFile, audioBuffer, r);
-
-    BOOST_LOG_TRIVIAL(info) << r.to_str();
+    DataWriterConfig files;
+    files.name = name;
+    files.format = Audio::WavFormat{TOTAL_CHANNELS, SAMPLE_RATE, BIT_DEPTH, Audio::SampleEncoding::PCM};
+    files.framesPerFile = SAMPLES_PER_FILE / TOTAL_CHANNELS;
+    files.secondsPerFile = RECORD_FILE_SECONDS;
+    files.syncBytes = WRITER_SYNC_BYTES;
+    files.direct = WRITER_DIRECT_IO;
+
+    // samples are copied to a writer thread so the capture loop never waits on the disk
+    AsyncWriter writer(files, fpga.dma.transferLength() / sizeof(uint32_t), WRITER_POOL_BYTES);
+
+    // the cancelled channels are filtered as they arrive and get their own
+    // files, batched so each writer block holds several ANC blocks
+    std::optional<AncStage> anc;
+    std::optional<AsyncWriter> cancelledWriter;
+    std::vector<uint32_t> cancelled(ANC_WRITER_BLOCK_SAMPLES);
+    std::size_t cancelledCount = 0;
+    if (RECORD_ANC)
+    {
+        DataWriterConfig ancFiles = files;
+        ancFiles.name = name + "_anc";
+        ancFiles.format.channels = NUM_CHANNELS;
+        anc.emplace(TOTAL_CHANNELS, SAMPLE_RATE, ANC_BLOCK_FRAMES);
+        cancelledWriter.emplace(ancFiles, cancelled.size(), ANC_WRITER_POOL_BYTES);
+    }
     std::signal(SIGINT, handler);
 
+    // the capture thread copies each DMA block into the ring and re-arms at
+    // once, this loop drains the ring at its own pace
+    SpscRing<uint32_t> captured(CAPTURE_RING_SAMPLES);
+    CaptureEngine capture(fpga.dma, CAPTURE_BUFFERS);
+    capture.attach(captured);
+    uint64_t reportedOverruns = 0;
+    uint64_t reportedRingDrops = 0;
+    uint64_t reportedDrops = 0;
+    uint64_t reportedMisses = 0;
+    capture.start();
+
     while (!recordingStopSignal)
     {
         if (fpga.dma.status == Status::ERROR)
@@ -127,64 +106,77 @@ int main()
             recordingStopSignal = 1;
         }
 
-        if (r.recordedSamples >= SAMPLES_PER_FILE)
+        if (capture.overruns() != reportedOverruns)
+        {
+            reportedOverruns = capture.overruns();
+            BOOST_LOG_TRIVIAL(warning) << "capture overruns " << reportedOverruns;
+        }
+        if (capture.ringDrops() != reportedRingDrops)
+        {
+            reportedRingDrops = capture.ringDrops();
+            BOOST_LOG_TRIVIAL(warning) << "capture ring dropped samples " << reportedRingDrops;
+        }
+        if (writer.drops() != reportedDrops)
         {
-            BOOST_LOG_TRIVIAL(info) << "save audiofile " << r.filename();
-            audioFile.setAudioBuffer(audioBuffer);
-            audioFile.save(r.filename(), AudioFileFormat::Wave);
-
-            r.file++;
-            r.recordedSamples = 0;
-            std::ranges::for_each(audioBuffer, [&BUFFER_LENGTH](auto &b)
-                                  { b.clear();
-                                    b.reserve(BUFFER_LENGTH); });
-            initialiseAudioFile(audioFile, audioBuffer, r);
+            reportedDrops = writer.drops();
+            BOOST_LOG_TRIVIAL(warning) << "writer dropped samples " << reportedDrops;
         }
-        else if (r.recordedSamples == audioBuffer.begin()->capacity())
+        if (anc && anc->deadlineMisses() != reportedMisses)
         {
-            // save wip
-            audioFile.setAudioBuffer(audioBuffer);
-            BOOST_LOG_TRIVIAL(info) << "save audiofile " << r.filename();
-            audioFile.save(r.filename(), AudioFileFormat::Wave);
-
-            // increase buffer size
-            size_t newBufferSize = audioBuffer[0].capacity() + SAMPLE_RATE;
-            BOOST_LOG_TRIVIAL(debug)
-                << "increase audio file buffer size from "
-                << audioBuffer[0].capacity()
-                << " to "
-                << newBufferSize;
-            std::ranges::for_each(audioBuffer, [newBufferSize](auto &b)
-                                  { b.reserve(newBufferSize); });
+            reportedMisses = anc->deadlineMisses();
+            BOOST_LOG_TRIVIAL(warning) << "anc deadline misses " << reportedMisses;
         }
 
-        // record sample packet
-        int bytesRecorded = fpga.dma.fillBuffer();
-        volatile int audioBufferLength = audioBuffer[0].size();
-        // BOOST_LOG_TRIVIAL(debug) << "recorded " << bytesRecorded << " bytes";
-        if (bytesRecorded > 0)
+        // store whole frames as they become available
+        auto frames = captured.peek();
+        frames = frames.first(frames.size() - frames.size() % TOTAL_CHANNELS);
+        if (!frames.empty())
         {
-            audioBuffer[0].insert(audioBuffer[0].end(), std::make_move_iterator(fpga.dma.buffer.begin()), std::make_move_iterator(fpga.dma.buffer.end()));
-            // BOOST_LOG_TRIVIAL(debug) << "stored " << bytesRecorded << " bytes";
-
-            // std::cout << "AUDIO BUFFER STATE:\n";
-            // std::ranges::for_each(audioBuffer[0], [](const auto &elem)
-            //                       { std::cout << std::hex << elem << std::dec << " "; });
-            // std::cout << "\n";
-            fpga.dma.buffer.clear();
-            r.recordedSamples += bytesRecorded / BYTES_PER_SAMPLE;
+            // raw samples are queued first, filtering never delays them
+            writer.push(frames);
+            for (auto pending = frames; anc && !pending.empty();)
+            {
+                auto block = pending.first(std::min(pending.size(), anc->blockSize() * TOTAL_CHANNELS));
+                auto out = std::span<uint32_t>(cancelled).subspan(cancelledCount, block.size() / TOTAL_CHANNELS * NUM_CHANNELS);
+                anc->process(block, out);
+                cancelledCount += out.size();
+
+                // queued once the batch cannot take another whole block
+                if (cancelled.size() - cancelledCount < anc->blockSize() * NUM_CHANNELS)
+                {
+                    cancelledWriter->push(std::span<const uint32_t>(cancelled).first(cancelledCount));
+                    cancelledCount = 0;
+                }
+                pending = pending.subspan(block.size());
+            }
+            captured.consume(frames.size());
         }
 
         // transfer more data
-        // BOOST_LOG_TRIVIAL(debug) << "spoofed " << transfer_size_bytes << " bytes";
-        fpga.dma.spoofData(transfer_size_bytes);
+        // BOOST_LOG_TRIVIAL(debug) << "spoofed " << fpga.dma.transferLength() << " bytes";
+        fpga.dma.spoofData(fpga.dma.transferLength());
     }
-    // save file
-    if (r.recordedSamples != 0)
+    capture.stop();
+    BOOST_LOG_TRIVIAL(info) << "captured " << capture.blocks() << " blocks with " << capture.overruns() << " overruns";
+
+    // write out what is queued and finalise the last file
+    writer.stop();
+    auto metrics = writer.metrics();
+    BOOST_LOG_TRIVIAL(info) << "wrote " << metrics.blocksWritten << " blocks, "
+                            << metrics.droppedSamples << " samples dropped, queue depth max "
+                            << metrics.maxQueueDepth << ", write latency mean "
+                            << metrics.meanWriteLatency.count() << " us max "
+                            << metrics.maxWriteLatency.count() << " us";
+
+    if (anc)
     {
-        BOOST_LOG_TRIVIAL(info)
-            << "save audiofile " << r.filename();
-        audioFile.save(r.filename(), AudioFileFormat::Wave);
+        cancelledWriter->push(std::span<const uint32_t>(cancelled).first(cancelledCount));
+        cancelledWriter->stop();
+        auto ancMetrics = anc->metrics();
+        BOOST_LOG_TRIVIAL(info) << "cancelled " << ancMetrics.frames << " frames in " << ancMetrics.blocks << " blocks, "
+                                << ancMetrics.deadlineMisses << " missed the " << ancMetrics.deadline.count()
+                                << " us deadline, latency max " << ancMetrics.maxLatency.count() << " us, "
+                                << cancelledWriter->drops() << " samples dropped";
     }
 
     return 0;
@@ -2,21 +2,21 @@
 #include <stdlib.h>
 #include <optional>
 #include <sstream>
+#include <string>
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <memory>
-
-#include <fcntl.h>
-#include <sys/mman.h>
+#include <utility>
 
 #include <boost/log/trivial.hpp>
 
 #include "config.h"
 #include "AxiStreamDma.h"
 
-void AxiStreamDma::dma_s2mm_status(volatile uint32_t *virtual_addr)
+void AxiStreamDma::dma_s2mm_status()
 {
-    uint32_t status = read(virtual_addr, S2MM_STATUS_REGISTER);
+    uint32_t status = read(S2MM_STATUS_REGISTER);
 
     printf("Stream to memory-mapped status (0x%08x@0x%02x):", status, S2MM_STATUS_REGISTER);
 
@@ -35,9 +35,9 @@ void AxiStreamDma::dma_s2mm_status(volatile uint32_t *virtual_addr)
     if (status & STATUS_ERR_IRQ) printf(" Error interrupt occurred.\n");
 }
 
-void AxiStreamDma::dma_mm2s_status(volatile uint32_t *virtual_addr)
+void AxiStreamDma::dma_mm2s_status()
 {
-    uint32_t status = read(virtual_addr, MM2S_STATUS_REGISTER);
+    uint32_t status = read(MM2S_STATUS_REGISTER);
 
     printf("Memory-mapped to stream status (0x%08x@0x%02x):", status, MM2S_STATUS_REGISTER);
 
@@ -58,33 +58,26 @@ void AxiStreamDma::dma_mm2s_status(volatile uint32_t *virtual_addr)
 
 AxiStreamDma::AxiStreamDma(AxiStreamDmaAddresses addresses) : addresses(addresses)
 {
+    setTransferLength(transfer_block_bytes);
+
     std::ostringstream debugStream;
     debugStream << "\n\tInitialise AxiStreamDma:";
 
-    ddr_memory_fd = open("/dev/mem", O_RDWR | O_SYNC);
-    if (ddr_memory_fd < 0)
+    DeviceBackend &device = GetDeviceBackend();
+    ctrl = device.MapRegisters(addresses.ctrl_baddr, addresses.ctrl_asize);
+    if (!ctrl)
     {
-        ddr_memory_fd = std::nullopt;
         status = Status::ERROR;
-        throw std::runtime_error("Failed to open /dev/mem");
-    }
-    debugStream << "\n\t\tdma.ddr_memory_fd " << ddr_memory_fd.value();
-
-    ctrl_vaddr = std::make_unique<Mmap>(nullptr, addresses.ctrl_asize, PROT_READ | PROT_WRITE, MAP_SHARED, ddr_memory_fd.value(), addresses.ctrl_baddr);
-    if (ctrl_vaddr->mem == MAP_FAILED)
-    {
-        ctrl_vaddr.reset();
-        status = Status::ERROR;
-        throw std::runtime_error("Failed to mmap ctrl_baddr");
+        throw std::runtime_error("Failed to map ctrl_baddr");
     }
     else
     {
-        debugStream << "\n\t\tdma.ctrl_vaddr    " << ctrl_vaddr
+        debugStream << "\n\t\tdma.ctrl_baddr    " << addresses.ctrl_baddr
                     << "\n\t\tdma.ctrl_asize    " << addresses.ctrl_asize;
     }
 
-    mm2s_vaddr = std::make_unique<Mmap>(nullptr, addresses.saxi_asize, PROT_READ | PROT_WRITE, MAP_SHARED, ddr_memory_fd.value(), addresses.mm2s_baddr);
-    if (mm2s_vaddr->mem == MAP_FAILED)
+    mm2s_vaddr = std::make_unique<Mmap>(addresses.mm2s_baddr, addresses.saxi_asize);
+    if (mm2s_vaddr->mem == nullptr)
     {
         mm2s_vaddr.reset();
         status = Status::ERROR;
@@ -92,12 +85,12 @@ AxiStreamDma::AxiStreamDma(AxiStreamDmaAddresses addresses) : addresses(addresse
     }
     else
     {
-        debugStream << "\n\t\tdma.mm2s_vaddr    " << mm2s_vaddr
+        debugStream << "\n\t\tdma.mm2s_vaddr    " << const_cast<unsigned int *>(mm2s_vaddr->mem)
                     << "\n\t\tdma.saxi_asize    " << addresses.saxi_asize;
     }
 
-    s2mm_vaddr = std::make_unique<Mmap>(nullptr, addresses.saxi_asize, PROT_READ | PROT_WRITE, MAP_SHARED, ddr_memory_fd.value(), addresses.s2mm_baddr);
-    if (s2mm_vaddr->mem == MAP_FAILED)
+    s2mm_vaddr = std::make_unique<Mmap>(addresses.s2mm_baddr, addresses.saxi_asize);
+    if (s2mm_vaddr->mem == nullptr)
     {
         s2mm_vaddr.reset();
         status = Status::ERROR;
@@ -105,98 +98,235 @@ AxiStreamDma::AxiStreamDma(AxiStreamDmaAddresses addresses) : addresses(addresse
     }
     else
     {
-        debugStream << "\n\t\tdma.s2mm_vaddr    " << s2mm_vaddr
+        debugStream << "\n\t\tdma.s2mm_vaddr    " << const_cast<unsigned int *>(s2mm_vaddr->mem)
                     << "\n\t\tdma.saxi_asize    " << addresses.saxi_asize;
     }
 
-    write(ctrl_vaddr->mem, MM2S_CONTROL_REGISTER, RUN_DMA);
-    write(ctrl_vaddr->mem, S2MM_CONTROL_REGISTER, RUN_DMA);
+    // Reset once here, the channels then stay running between blocks
+    write(MM2S_CONTROL_REGISTER, RESET_DMA);
+    while (read(MM2S_CONTROL_REGISTER) & RESET_DMA)
+        ;
+    write(MM2S_CONTROL_REGISTER, RUN_DMA | ENABLE_ALL_IRQ);
+    write(S2MM_CONTROL_REGISTER, RUN_DMA | ENABLE_ALL_IRQ);
+    debugStream << "\n\t\tdma.transferBytes " << transferBytes;
+
+    // A simulated device signals its own interrupts, the board needs UIO
+    int mm2sIrq = device.GetIrqFd(addresses.ctrl_baddr, false);
+    int s2mmIrq = device.GetIrqFd(addresses.ctrl_baddr, true);
+    mm2sCompletion = mm2sIrq >= 0 ? std::make_unique<IrqCompletion>(mm2sIrq, false) : MakeCompletion(MM2S_IRQ_DEVICE);
+    s2mmCompletion = s2mmIrq >= 0 ? std::make_unique<IrqCompletion>(s2mmIrq, false) : MakeCompletion(S2MM_IRQ_DEVICE);
+    debugStream << "\n\t\tdma.mm2s_irq      " << (dynamic_cast<IrqCompletion *>(mm2sCompletion.get()) ? "interrupt" : "polling")
+                << "\n\t\tdma.s2mm_irq      " << (dynamic_cast<IrqCompletion *>(s2mmCompletion.get()) ? "interrupt" : "polling");
+
     status = Status::INITIALISED;
     BOOST_LOG_TRIVIAL(debug) << debugStream.str();
 };
 
-int AxiStreamDma::spoofData(int bytesToTransfer)
+void AxiStreamDma::setTransferLength(std::size_t bytes)
 {
-    mm2s_vaddr->mem[0] = 0xDEADBEEF;
-    mm2s_vaddr->mem[1] = 0x12345678;
+    if (bytes == 0 || bytes % sizeof(uint32_t) != 0 || bytes > addresses.saxi_asize)
+        throw std::invalid_argument("DMA transfer length must be whole samples that fit the mapped buffers");
+    if (bytes >= (std::size_t{1} << DMA_LENGTH_REGISTER_BITS))
+        throw std::invalid_argument("DMA transfer length must fit the " + std::to_string(DMA_LENGTH_REGISTER_BITS) + " bit length register");
 
+    transferBytes = bytes;
+    mm2sSlot = 0;
+    spoofBlock.resize(bytes / sizeof(int32_t));
+    for (std::size_t i = 0; i < spoofBlock.size(); i++)
+        spoofBlock[i] = static_cast<int32_t>(i % 2 == 0 ? 0xDEADBEEF : 0x12345678);
+}
+
+std::size_t AxiStreamDma::transferLength() const
+{
+    return transferBytes;
+}
+
+int AxiStreamDma::spoofData(int bytesToTransfer)
+{
     int bytesTransferred = 0;
-    for (; bytesTransferred < bytesToTransfer; bytesTransferred += transfer_size_bytes)
+    while (bytesTransferred < bytesToTransfer)
     {
-        write(ctrl_vaddr->mem, MM2S_CONTROL_REGISTER, RESET_DMA);
-		write(ctrl_vaddr->mem, MM2S_CONTROL_REGISTER, HALT_DMA);
-		write(ctrl_vaddr->mem, MM2S_CONTROL_REGISTER, ENABLE_ALL_IRQ);
-        write(ctrl_vaddr->mem, MM2S_CONTROL_REGISTER, RUN_DMA);
-        write(ctrl_vaddr->mem, MM2S_SRC_ADDRESS_REGISTER, mm2s_baddr);
-        write(ctrl_vaddr->mem, MM2S_TRNSFR_LENGTH_REGISTER, transfer_size_bytes);
-        sync(ctrl_vaddr->mem, MM2S_STATUS_REGISTER);
-        dma_s2mm_status(ctrl_vaddr->mem);
-        dma_mm2s_status(ctrl_vaddr->mem);
+        std::size_t samples = (static_cast<std::size_t>(bytesToTransfer - bytesTransferred) + sizeof(int32_t) - 1) / sizeof(int32_t);
+        std::size_t sent = sendData(std::span<const int32_t>(spoofBlock).first(std::min(samples, spoofBlock.size())));
+        if (sent == 0)
+            break;
+        bytesTransferred += static_cast<int>(sent * sizeof(int32_t));
     }
     return bytesTransferred;
 }
 
-int AxiStreamDma::sendData(std::vector<int32_t> &data, uint32_t idx)
+std::size_t AxiStreamDma::sendData(std::span<const int32_t> samples)
+{
+    std::size_t count = std::min(samples.size(), transferBytes / sizeof(int32_t));
+    if (count == 0)
+        return 0;
+
+    // The MM2S buffer holds two blocks when it can, so this one is copied in
+    // while the previous one is still being read out. A single block has to
+    // wait for the read out before it is overwritten.
+    bool doubleBuffered = slots() >= 2;
+    auto waitIdle = [this]
+    {
+        if (mm2sBusy && !waitComplete(MM2S_STATUS_REGISTER))
+            return false;
+        mm2sBusy = false;
+        return true;
+    };
+
+    if (!doubleBuffered && !waitIdle())
+        return 0;
+    volatile unsigned int *slot = mm2s_vaddr->mem + mm2sSlot * transferBytes / sizeof(int32_t);
+    std::copy_n(samples.begin(), count, slot);
+    if (doubleBuffered && !waitIdle())
+        return 0;
+
+    write(MM2S_SRC_ADDRESS_REGISTER, addresses.mm2s_baddr + mm2sSlot * transferBytes);
+    // Writing the length starts the transfer
+    write(MM2S_TRNSFR_LENGTH_REGISTER, count * sizeof(int32_t));
+    mm2sBusy = true;
+    mm2sSlot = doubleBuffered ? 1 - mm2sSlot : 0;
+
+    return count;
+}
+
+ReceivedBlock AxiStreamDma::receive()
 {
-    mm2s_vaddr->mem[0] = data[idx];
-    mm2s_vaddr->mem[1] = data[idx + 1];
+    if (lent)
+        throw std::runtime_error("Previous ReceivedBlock must be released before receiving again");
 
-    write(ctrl_vaddr->mem, MM2S_CONTROL_REGISTER, RESET_DMA);
-    write(ctrl_vaddr->mem, MM2S_CONTROL_REGISTER, HALT_DMA);
-    write(ctrl_vaddr->mem, MM2S_CONTROL_REGISTER, ENABLE_ALL_IRQ);
-    write(ctrl_vaddr->mem, MM2S_CONTROL_REGISTER, RUN_DMA);
-    write(ctrl_vaddr->mem, MM2S_SRC_ADDRESS_REGISTER, mm2s_baddr);
-    write(ctrl_vaddr->mem, MM2S_TRNSFR_LENGTH_REGISTER, transfer_size_bytes);
-    sync(ctrl_vaddr->mem, MM2S_STATUS_REGISTER);
-    dma_s2mm_status(ctrl_vaddr->mem);
-    dma_mm2s_status(ctrl_vaddr->mem);
+    if (!s2mmArmed)
+        armReceive(0);
 
-    return transfer_size_bytes;
+    std::size_t bytesTransferred = receiveComplete();
+    if (bytesTransferred == 0)
+        return {};
+
+    // The samples stay where the DMA wrote them until the block is released
+    lent = true;
+    return ReceivedBlock(this, 0, slotSamples(0, bytesTransferred));
 }
 
-int AxiStreamDma::fillBuffer()
+void AxiStreamDma::release(std::size_t)
 {
-    int bytesTransferred = 0;
-    while (read(ctrl_vaddr->mem, S2MM_STATUS_REGISTER) != 0 && read(ctrl_vaddr->mem, S2MM_STATUS_REGISTER) != STATUS_IOC_IRQ)
-    {
-        write(ctrl_vaddr->mem, S2MM_CONTROL_REGISTER, RESET_DMA);
-        write(ctrl_vaddr->mem, S2MM_CONTROL_REGISTER, HALT_DMA);
-        write(ctrl_vaddr->mem, S2MM_CONTROL_REGISTER, ENABLE_ALL_IRQ);
-        write(ctrl_vaddr->mem, S2MM_CONTROL_REGISTER, RUN_DMA);
-        write(ctrl_vaddr->mem, S2MM_DST_ADDRESS_REGISTER, s2mm_baddr + bytesTransferred);
-        write(ctrl_vaddr->mem, S2MM_BUFF_LENGTH_REGISTER, transfer_size_bytes);
-        sync(ctrl_vaddr->mem, S2MM_STATUS_REGISTER);
-        dma_s2mm_status(ctrl_vaddr->mem);
-        dma_mm2s_status(ctrl_vaddr->mem);
-        bytesTransferred += transfer_size_bytes;
-    }
+    lent = false;
+}
+
+std::size_t AxiStreamDma::slots() const
+{
+    return addresses.saxi_asize / transferBytes;
+}
 
-    if (bytesTransferred > 0)
+void AxiStreamDma::armReceive(std::size_t slot)
+{
+    write(S2MM_DST_ADDRESS_REGISTER, addresses.s2mm_baddr + slot * transferBytes);
+    // Writing the length starts the transfer
+    write(S2MM_BUFF_LENGTH_REGISTER, transferBytes);
+    s2mmArmed = true;
+}
+
+std::size_t AxiStreamDma::receiveComplete()
+{
+    if (!s2mmArmed || !complete(S2MM_STATUS_REGISTER))
+        return 0;
+    s2mmArmed = false;
+
+    // Bytes actually received, a block ends early if the stream asserts TLAST
+    return read(S2MM_BUFF_LENGTH_REGISTER);
+}
+
+std::size_t AxiStreamDma::waitReceiveComplete(std::chrono::microseconds timeout)
+{
+    std::size_t bytesTransferred = 0;
+    if (s2mmArmed)
+        s2mmCompletion->Wait([&]()
+                             { return (bytesTransferred = receiveComplete()) != 0 || status == Status::ERROR; },
+                             timeout);
+    return bytesTransferred;
+}
+
+std::span<const uint32_t> AxiStreamDma::slotSamples(std::size_t slot, std::size_t bytes) const
+{
+    const auto *samples = const_cast<const uint32_t *>(s2mm_vaddr->mem) + slot * transferBytes / sizeof(uint32_t);
+    return {samples, bytes / sizeof(uint32_t)};
+}
+
+ReceivedBlock::ReceivedBlock(ReceivedBlock &&other) noexcept : owner(std::exchange(other.owner, nullptr)), slot(other.slot), samples(std::exchange(other.samples, {})) {};
+
+ReceivedBlock &ReceivedBlock::operator=(ReceivedBlock &&other) noexcept
+{
+    if (this != &other)
     {
-        size_t bufferSize = buffer.size();
-        buffer.resize(bufferSize + bytesTransferred / 4);
-        std::memcpy(buffer.data() + bufferSize,  const_cast<const unsigned int *>(s2mm_vaddr->mem), bytesTransferred);
+        release();
+        owner = std::exchange(other.owner, nullptr);
+        slot = other.slot;
+        samples = std::exchange(other.samples, {});
     }
+    return *this;
+}
 
-    return bytesTransferred;
+ReceivedBlock::~ReceivedBlock()
+{
+    release();
 }
 
-unsigned int AxiStreamDma::read(volatile unsigned int *virtual_addr, int offset)
+void ReceivedBlock::release()
 {
-	return virtual_addr[offset >> 2];
+    if (owner != nullptr)
+        owner->release(slot);
+    owner = nullptr;
+    samples = {};
+}
+
+unsigned int AxiStreamDma::read(int offset)
+{
+	return ctrl->Read(offset);
 };
 
-void AxiStreamDma::write(volatile unsigned int *virtual_addr, int offset, unsigned int value)
+void AxiStreamDma::write(int offset, unsigned int value)
 {
-	virtual_addr[offset >> 2] = value;
+	ctrl->Write(offset, value);
 };
 
-void AxiStreamDma::sync(volatile unsigned int *virtual_addr, int status_register)
+bool AxiStreamDma::complete(int status_register)
 {
-    volatile unsigned int status = read(virtual_addr, status_register);
-    // Wait until both IOC_IRQ and IDLE are set
-    while (( (status & IOC_IRQ_FLAG) == 0 ) || ( (status & IDLE_FLAG) == 0 ))
+    unsigned int dmaStatus = read(status_register);
+    if (dmaStatus & STATUS_DMA_ALL_ERR)
     {
-        status = read(virtual_addr, status_register);
+        if (status != Status::ERROR)
+        {
+            BOOST_LOG_TRIVIAL(error) << "DMA error, status register 0x" << std::hex << dmaStatus << std::dec;
+            dma_s2mm_status();
+            dma_mm2s_status();
+        }
+        status = Status::ERROR;
+        return false;
     }
-};
+
+    if ((dmaStatus & STATUS_IOC_IRQ) == 0)
+        return false;
+
+    // Interrupt bits are write one to clear
+    write(status_register, STATUS_IOC_IRQ);
+    return true;
+}
+
+bool AxiStreamDma::waitComplete(int status_register)
+{
+    auto &completion = status_register == S2MM_STATUS_REGISTER ? *s2mmCompletion : *mm2sCompletion;
+    bool done = false;
+    completion.Wait([&]()
+                    { return (done = complete(status_register)) || status == Status::ERROR; },
+                    DMA_WAIT_TIMEOUT);
+    return done;
+}
+
+void AxiStreamDma::setCompletion(int status_register, std::unique_ptr<Completion> completion)
+{
+    if (!completion)
+        completion = std::make_unique<PollingCompletion>();
+
+    if (status_register == S2MM_STATUS_REGISTER)
+        s2mmCompletion = std::move(completion);
+    else
+        mm2sCompletion = std::move(completion);
+}
@@ -1,11 +1,17 @@
 #pragma once
 
 #include <vector>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <memory>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
 
-#include <fcntl.h>
-#include <sys/mman.h>
+#include "Completion.h"
+#include "DeviceBackend.h"
 
 #define MM2S_CONTROL_REGISTER 0x00
 #define MM2S_STATUS_REGISTER 0x04
@@ -32,6 +38,7 @@
 #define STATUS_IOC_IRQ 0x00001000
 #define STATUS_DELAY_IRQ 0x00002000
 #define STATUS_ERR_IRQ 0x00004000
+#define STATUS_DMA_ALL_ERR 0x00000070
 
 #define HALT_DMA 0x00000000
 #define RUN_DMA 0x00000001
@@ -41,20 +48,21 @@
 #define ENABLE_ERR_IRQ 0x00004000
 #define ENABLE_ALL_IRQ 0x00007000
 
+// Physical memory mapped through the device backend, /dev/mem on the board
 struct Mmap
 {
     volatile unsigned int *mem = nullptr;
     size_t size = 0;
-    Mmap(void *start, size_t size, int prot, int flags, int fd, uint32_t baddr)
+    Mmap(uint32_t baddr, size_t size)
     {
-        mem = static_cast<unsigned int *>(mmap(start, size, prot, flags, fd, baddr));
+        mem = static_cast<volatile unsigned int *>(GetDeviceBackend().MapMemory(baddr, size));
         this->size = size;
     };
 
     ~Mmap()
     {
-        if (mem != nullptr && mem != MAP_FAILED && munmap(const_cast<unsigned int*>(mem), size) == -1)
-            std::runtime_error("Failed to delete MmapPointer memory!");
+        if (mem != nullptr)
+            GetDeviceBackend().UnmapMemory(const_cast<unsigned int *>(mem), size);
     };
 };
 
@@ -76,29 +84,97 @@ struct AxiStreamDmaAddresses
     const uint32_t saxi_asize;
 };
 
-class AxiStreamDma
+// Whatever lends out S2MM buffers, told when a buffer may be reused
+class BlockOwner
 {
-    std::optional<int> ddr_memory_fd = std::nullopt;
-    std::unique_ptr<Mmap> ctrl_vaddr;
+public:
+    virtual void release(std::size_t slot) = 0;
+
+protected:
+    ~BlockOwner() = default;
+};
+
+// Samples received by the S2MM channel, read in place from the DMA buffer. The
+// buffer slot is handed back to its owner when the block is released or
+// destroyed.
+class ReceivedBlock : public std::ranges::view_interface<ReceivedBlock>
+{
+    BlockOwner *owner = nullptr;
+    std::size_t slot = 0;
+    std::span<const uint32_t> samples;
+
+public:
+    ReceivedBlock() = default;
+    ReceivedBlock(BlockOwner *owner, std::size_t slot, std::span<const uint32_t> samples) : owner(owner), slot(slot), samples(samples) {};
+    ReceivedBlock(ReceivedBlock &&other) noexcept;
+    ReceivedBlock &operator=(ReceivedBlock &&other) noexcept;
+    ~ReceivedBlock();
+
+    const uint32_t *begin() const
+    {
+        return samples.data();
+    }
+
+    const uint32_t *end() const
+    {
+        return samples.data() + samples.size();
+    }
+
+    std::span<const uint32_t> span() const
+    {
+        return samples;
+    }
+
+    void release();
+};
+
+class AxiStreamDma : public BlockOwner
+{
+    std::unique_ptr<RegisterBlock> ctrl;
     std::unique_ptr<Mmap> mm2s_vaddr;
     std::unique_ptr<Mmap> s2mm_vaddr;
+    bool lent = false;
+
+    // Channels are started once, each block is a single length register write
+    std::size_t transferBytes;
+    bool s2mmArmed = false;
+    bool mm2sBusy = false;
+    std::size_t mm2sSlot = 0;
+    std::vector<int32_t> spoofBlock;
+
+    // Sleep on the channel interrupts when UIO devices are configured
+    std::unique_ptr<Completion> mm2sCompletion;
+    std::unique_ptr<Completion> s2mmCompletion;
+
+    bool complete(int status_register);
+    void release(std::size_t slot) override;
 
 public:
-    Status status = Status::STOPPED;
-    std::vector<std::uint32_t> buffer;
+    std::atomic<Status> status = Status::STOPPED;
 
     const AxiStreamDmaAddresses addresses;
 
     AxiStreamDma(AxiStreamDmaAddresses addresses);
 
-    int sendData(std::vector<int32_t> &data, uint32_t idx);
-    int spoofData(int transfers);
-    int fillBuffer();
+    void setTransferLength(std::size_t bytes);
+    std::size_t transferLength() const;
+
+    std::size_t sendData(std::span<const int32_t> samples);
+    int spoofData(int bytesToTransfer);
+    ReceivedBlock receive();
+
+    // The S2MM buffer split into transfer length slots, for rotating captures
+    std::size_t slots() const;
+    void armReceive(std::size_t slot);
+    std::size_t receiveComplete();
+    std::size_t waitReceiveComplete(std::chrono::microseconds timeout);
+    std::span<const uint32_t> slotSamples(std::size_t slot, std::size_t bytes) const;
 
-    unsigned int read(volatile unsigned int *virtual_addr, int offset);
-    void write(volatile unsigned int *virtual_addr, int offset, unsigned int value);
-    void sync(volatile unsigned int *virtual_addr, int status_register);
+    unsigned int read(int offset);
+    void write(int offset, unsigned int value);
+    bool waitComplete(int status_register);
+    void setCompletion(int status_register, std::unique_ptr<Completion> completion);
 
-    void dma_s2mm_status(volatile uint32_t *virtual_addr);
-    void dma_mm2s_status(volatile uint32_t *virtual_addr);
+    void dma_s2mm_status();
+    void dma_mm2s_status();
 };
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "ancstage.h"
+#include "interleave.h"
+
+// 24 bit full scale, the filters run on samples normalised to (-1, 1)
+constexpr float ADC_FULL_SCALE = 1 << 23;
+
+static uint32_t fromFloat(float sample)
+{
+    float scaled = std::clamp(sample * ADC_FULL_SCALE, -ADC_FULL_SCALE, ADC_FULL_SCALE - 1);
+    return static_cast<uint32_t>(static_cast<int32_t>(std::lround(scaled)));
+}
+
+AncStage::AncStage(std::size_t channels, uint32_t sampleRate, std::size_t blockFrames)
+    : channels(channels), blockFrames(blockFrames),
+      leakyRef(ANC_LEAKY_ALPHA, 1.0F - ANC_LEAKY_ALPHA, 0.0F), leakyOpt(ANC_LEAKY_ALPHA, 1.0F - ANC_LEAKY_ALPHA, 0.0F),
+      filter(ANC_STEP_SIZE, ANC_STEP_ALPHA, ANC_STEP_GAMMA, std::numeric_limits<float>::min(), ANC_STEP_SIZE / 100.0F, ANC_STEP_SIZE * 100.0F),
+      planar(channels * blockFrames), ref(blockFrames * NUM_CHANNELS), opt(blockFrames * NUM_CHANNELS), err(blockFrames * NUM_CHANNELS)
+{
+    if (blockFrames == 0 || sampleRate == 0)
+        throw std::invalid_argument("AncStage needs a block size and sample rate");
+    for (std::size_t pair = 0; pair < NUM_CHANNELS; pair++)
+        if (ANC_REFERENCE_CHANNELS[pair] >= channels || ANC_OPTRODE_CHANNELS[pair] >= channels)
+            throw std::invalid_argument("ANC channel map is outside the captured frames");
+
+    for (std::size_t channel = 0; channel < channels; channel++)
+        planarChannels.push_back(std::span<int32_t>(planar).subspan(channel * blockFrames, blockFrames));
+
+    // Filtering may use this share of the time the block took to capture
+    auto period = std::chrono::duration<double>(static_cast<double>(blockFrames) / sampleRate);
+    deadline = std::chrono::duration_cast<std::chrono::nanoseconds>(period * ANC_DEADLINE_LOAD);
+}
+
+bool AncStage::process(std::span<const uint32_t> samples, std::span<uint32_t> cancelled)
+{
+    std::size_t frames = samples.size() / channels;
+    if (samples.size() % channels != 0 || frames > blockFrames)
+        throw std::invalid_argument("AncStage blocks must be at most blockSize() whole frames");
+    if (cancelled.size() != frames * NUM_CHANNELS)
+        throw std::invalid_argument("AncStage output does not match the block");
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Split the frames into channels, the same bits read as signed
+    std::span<const int32_t> words(reinterpret_cast<const int32_t *>(samples.data()), samples.size());
+    Audio::deinterleave<int32_t>(words, planarChannels);
+
+    // Gather the pairs, the ADC leaves bit 23 unextended in the top byte
+    for (std::size_t pair = 0; pair < NUM_CHANNELS; pair++)
+    {
+        auto refChannel = planarChannels[ANC_REFERENCE_CHANNELS[pair]].first(frames);
+        auto optChannel = planarChannels[ANC_OPTRODE_CHANNELS[pair]].first(frames);
+        Audio::signExtend24(refChannel);
+        Audio::signExtend24(optChannel);
+        for (std::size_t frame = 0; frame < frames; frame++)
+        {
+            ref[frame * NUM_CHANNELS + pair] = static_cast<float>(refChannel[frame]) / ADC_FULL_SCALE;
+            opt[frame * NUM_CHANNELS + pair] = static_cast<float>(optChannel[frame]) / ADC_FULL_SCALE;
+        }
+    }
+
+    // Remove their DC in place, all pairs at once
+    std::size_t count = frames * NUM_CHANNELS;
+    auto refSpan = std::span<float>(ref).first(count);
+    auto optSpan = std::span<float>(opt).first(count);
+    auto errSpan = std::span<float>(err).first(count);
+    leakyRef.removeDc(refSpan, refSpan);
+    leakyOpt.removeDc(optSpan, optSpan);
+
+    filter.process(optSpan, refSpan, errSpan);
+
+    for (std::size_t idx = 0; idx < count; idx++)
+        cancelled[idx] = fromFloat(optSpan[idx] - errSpan[idx]);
+
+    lastLatency = std::chrono::steady_clock::now() - start;
+    maxLatency = std::max(maxLatency, lastLatency);
+    blockCount++;
+    frameCount += frames;
+
+    // Short blocks get the matching share of the deadline
+    bool met = lastLatency * blockFrames <= deadline * frames;
+    if (!met)
+        missCount++;
+    return met;
+}
+
+AncMetrics AncStage::metrics() const
+{
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    return {
+        blockCount,
+        frameCount,
+        missCount,
+        duration_cast<microseconds>(deadline),
+        duration_cast<microseconds>(lastLatency),
+        duration_cast<microseconds>(maxLatency),
+    };
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "config.h"
+#include "leakyIntegrator.h"
+#include "lmsBank.h"
+
+struct AncMetrics
+{
+    uint64_t blocks;
+    uint64_t frames;
+    uint64_t deadlineMisses; // blocks filtered later than their deadline
+    std::chrono::microseconds deadline;
+    std::chrono::microseconds lastLatency;
+    std::chrono::microseconds maxLatency;
+};
+
+// Live noise cancellation of captured frames, the lmsDemo chain run as the
+// samples arrive. Each optrode channel and its reference in
+// ANC_OPTRODE_CHANNELS/ANC_REFERENCE_CHANNELS have their DC removed by a
+// leaky integrator, then one VSS NLMS filter per pair runs in an LMS::Bank.
+//
+// Every block must be filtered within ANC_DEADLINE_LOAD of the time it took
+// to capture, or the stage cannot keep up with the ADC. Late blocks are still
+// filtered, and counted so the recorder can report them.
+class AncStage
+{
+    using Filter = LMS::Bank<float, ANC_TAPS, NUM_CHANNELS>;
+
+    std::size_t channels; // interleaved in the captured frames
+    std::size_t blockFrames;
+    std::chrono::nanoseconds deadline;
+
+    LeakyBank<float, NUM_CHANNELS> leakyRef;
+    LeakyBank<float, NUM_CHANNELS> leakyOpt;
+    Filter filter;
+
+    // one block of each captured channel, split out of the frames
+    std::vector<int32_t> planar;
+    std::vector<std::span<int32_t>> planarChannels;
+
+    // one block of NUM_CHANNELS interleaved samples per frame
+    std::vector<float> ref;
+    std::vector<float> opt;
+    std::vector<float> err;
+
+    uint64_t blockCount = 0;
+    uint64_t frameCount = 0;
+    uint64_t missCount = 0;
+    std::chrono::nanoseconds lastLatency{0};
+    std::chrono::nanoseconds maxLatency{0};
+
+public:
+    AncStage(std::size_t channels, uint32_t sampleRate, std::size_t blockFrames);
+
+    // Filters at most blockSize() whole frames of captured samples, writing
+    // NUM_CHANNELS cancelled samples per frame to cancelled. Returns false
+    // when the block missed its deadline.
+    bool process(std::span<const uint32_t> samples, std::span<uint32_t> cancelled);
+
+    std::size_t blockSize() const
+    {
+        return blockFrames;
+    }
+
+    uint64_t deadlineMisses() const
+    {
+        return missCount;
+    }
+
+    AncMetrics metrics() const;
+};
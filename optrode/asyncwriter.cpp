@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+#include <boost/log/trivial.hpp>
+
+#include "asyncwriter.h"
+
+AsyncWriter::AsyncWriter(DataWriterConfig config, std::size_t blockSamples, std::size_t poolBytes)
+    : channels(config.format.channels), blockSamples(blockSamples - blockSamples % channels), file(std::move(config)),
+      pool(poolBytes, this->blockSamples), filled(std::bit_ceil(pool.blocks()))
+{
+    running = true;
+    worker = std::thread(&AsyncWriter::write, this);
+}
+
+AsyncWriter::~AsyncWriter()
+{
+    stop();
+}
+
+bool AsyncWriter::push(std::span<const uint32_t> samples)
+{
+    samples = samples.first(samples.size() - samples.size() % channels);
+    while (!samples.empty())
+    {
+        std::size_t count = std::min(samples.size(), blockSamples);
+        if (!queue(samples.first(count)))
+        {
+            dropCount.fetch_add(samples.size(), std::memory_order_relaxed);
+            return false;
+        }
+        samples = samples.subspan(count);
+    }
+    return true;
+}
+
+bool AsyncWriter::queue(std::span<const uint32_t> samples)
+{
+    std::size_t index;
+    if (!pool.acquire(index))
+        return false;
+
+    std::copy(samples.begin(), samples.end(), pool.block(index).begin());
+    filled.push({index, samples.size()});
+
+    std::size_t depth = filled.size();
+    if (depth > maxDepth.load(std::memory_order_relaxed))
+        maxDepth.store(depth, std::memory_order_relaxed);
+    return true;
+}
+
+void AsyncWriter::stop()
+{
+    running = false;
+    if (worker.joinable())
+        worker.join();
+}
+
+uint64_t AsyncWriter::drops() const
+{
+    return dropCount.load(std::memory_order_relaxed);
+}
+
+WriterMetrics AsyncWriter::metrics() const
+{
+    uint64_t blocks = blockCount.load(std::memory_order_relaxed);
+    int64_t total = totalLatencyUs.load(std::memory_order_relaxed);
+    return {
+        filled.size(),
+        maxDepth.load(std::memory_order_relaxed),
+        blocks,
+        sampleCount.load(std::memory_order_relaxed),
+        dropCount.load(std::memory_order_relaxed),
+        std::chrono::microseconds(lastLatencyUs.load(std::memory_order_relaxed)),
+        std::chrono::microseconds(maxLatencyUs.load(std::memory_order_relaxed)),
+        std::chrono::microseconds(blocks > 0 ? total / static_cast<int64_t>(blocks) : 0),
+    };
+}
+
+bool AsyncWriter::writeBlock(const Block &block)
+{
+    if (file.getStatus() != WriterStatus::WRITING)
+        return false;
+
+    auto start = std::chrono::steady_clock::now();
+    file.write(pool.block(block.index).first(block.count));
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    lastLatencyUs.store(latency, std::memory_order_relaxed);
+    if (latency > maxLatencyUs.load(std::memory_order_relaxed))
+        maxLatencyUs.store(latency, std::memory_order_relaxed);
+    totalLatencyUs.fetch_add(latency, std::memory_order_relaxed);
+    sampleCount.fetch_add(block.count, std::memory_order_relaxed);
+    blockCount.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void AsyncWriter::write()
+{
+    Block block;
+    bool dirty = false;
+    auto flushed = std::chrono::steady_clock::now();
+    while (true)
+    {
+        if (!filled.pop(block))
+        {
+            // Drain what was queued before stop()
+            if (!running.load(std::memory_order_acquire) && filled.empty())
+                break;
+
+            auto now = std::chrono::steady_clock::now();
+            if (dirty && now - flushed >= WRITER_FLUSH_INTERVAL)
+            {
+                try
+                {
+                    file.sync();
+                }
+                catch (const std::exception &e)
+                {
+                    BOOST_LOG_TRIVIAL(error) << "writer failed to flush: " << e.what();
+                }
+                dirty = false;
+                flushed = now;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        dirty = true;
+
+        try
+        {
+            if (!writeBlock(block))
+                dropCount.fetch_add(block.count, std::memory_order_relaxed);
+        }
+        catch (const std::exception &e)
+        {
+            // Keep draining so the producer never stalls, the samples are lost
+            BOOST_LOG_TRIVIAL(error) << "writer failed: " << e.what();
+            dropCount.fetch_add(block.count, std::memory_order_relaxed);
+            closeFile();
+        }
+        pool.release(block.index);
+    }
+
+    closeFile();
+}
+
+void AsyncWriter::closeFile()
+{
+    try
+    {
+        file.close();
+    }
+    catch (const std::exception &e)
+    {
+        BOOST_LOG_TRIVIAL(error) << "writer failed to close: " << e.what();
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <thread>
+
+#include "datawriter.h"
+#include "samplepool.h"
+#include "spscQueue.h"
+
+// how often an idle writer syncs its file, bounding what a crash loses
+constexpr auto WRITER_FLUSH_INTERVAL = std::chrono::seconds(1);
+
+struct WriterMetrics
+{
+    std::size_t queueDepth;    // blocks waiting to be written
+    std::size_t maxQueueDepth; // deepest the queue has been
+    uint64_t blocksWritten;
+    uint64_t samplesWritten;
+    uint64_t droppedSamples; // pushed with no free block
+    std::chrono::microseconds lastWriteLatency;
+    std::chrono::microseconds maxWriteLatency;
+    std::chrono::microseconds meanWriteLatency;
+};
+
+// Hands samples to a DataWriter on a writer thread, so the capture loop only
+// copies into a block from a fixed SamplePool and never waits on the disk. The files rotate as
+// the DataWriter is configured, and are synced while the writer is idle.
+//
+// push() and stop() must be called from one producer thread. When the writer
+// falls behind and no block is free, push() drops the samples and counts them
+// rather than blocking.
+class AsyncWriter
+{
+    struct Block
+    {
+        std::size_t index;
+        std::size_t count;
+    };
+
+    std::size_t channels;
+    std::size_t blockSamples;
+    DataWriter file;
+    SamplePool pool;           // released by the writer
+    SpscRing<Block> filled;    // producer to writer, holds every block of the pool
+
+    std::atomic<bool> running = false;
+    std::atomic<std::size_t> maxDepth = 0;
+    std::atomic<uint64_t> blockCount = 0;
+    std::atomic<uint64_t> sampleCount = 0;
+    std::atomic<uint64_t> dropCount = 0;
+    std::atomic<int64_t> lastLatencyUs = 0;
+    std::atomic<int64_t> maxLatencyUs = 0;
+    std::atomic<int64_t> totalLatencyUs = 0;
+    std::thread worker;
+
+    void write();
+    void closeFile();
+    bool writeBlock(const Block &block);
+    bool queue(std::span<const uint32_t> samples);
+
+public:
+    // Opens the first file and allocates poolBytes of blocks up front,
+    // blockSamples is rounded down to whole frames
+    AsyncWriter(DataWriterConfig config, std::size_t blockSamples, std::size_t poolBytes);
+    ~AsyncWriter();
+
+    AsyncWriter(const AsyncWriter &) = delete;
+    AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+    // Copy whole frames into the queue, false if some were dropped
+    bool push(std::span<const uint32_t> samples);
+
+    // Write everything queued and close the last file
+    void stop();
+
+    // Samples lost because the writer was behind or failed
+    uint64_t drops() const;
+    WriterMetrics metrics() const;
+};
@@ -12,11 +12,24 @@
 
 #include "config.h"
 #include "board.h"
+#include "SimulatedBackend.h"
 
 namespace LRB
 {
 
-    Board::Board(AxiStreamDmaAddresses addresses) : dma(addresses){};
+    // AXIDMA_DEVICE in the environment wins over the configured backend
+    static DeviceBackend &selectDevice()
+    {
+        if (std::getenv("AXIDMA_DEVICE") == nullptr)
+            SetDeviceBackend(MakeDeviceBackend(DEVICE_BACKEND));
+
+        DeviceBackend &device = GetDeviceBackend();
+        if (dynamic_cast<SimulatedBackend *>(&device) != nullptr)
+            BOOST_LOG_TRIVIAL(warning) << "LRB running on the simulated DMA device";
+        return device;
+    }
+
+    Board::Board(AxiStreamDmaAddresses addresses) : device(selectDevice()), dma(addresses){};
 
     void Board::logDebugInformation()
     {
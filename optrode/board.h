@@ -7,6 +7,7 @@ namespace LRB
     class Board
     {
     public:
+        DeviceBackend &device; // selected before dma maps through it
         AxiStreamDma dma;
 
         Board(AxiStreamDmaAddresses addresses);
@@ -0,0 +1,147 @@
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include "captureengine.h"
+
+CaptureEngine::CaptureEngine(AxiStreamDma &dma, std::size_t buffers) : dma(dma), buffers(buffers)
+{
+    if (buffers < 2 || buffers > MAX_CAPTURE_BUFFERS)
+        throw std::invalid_argument("CaptureEngine needs between 2 and " + std::to_string(MAX_CAPTURE_BUFFERS) + " buffers");
+    if (buffers > dma.slots())
+        throw std::invalid_argument("CaptureEngine buffers do not fit the mapped S2MM memory");
+}
+
+CaptureEngine::~CaptureEngine()
+{
+    stop();
+}
+
+void CaptureEngine::attach(SpscRing<uint32_t> &ring)
+{
+    if (running)
+        throw std::logic_error("CaptureEngine ring must be attached before start()");
+    this->ring = &ring;
+}
+
+void CaptureEngine::start()
+{
+    if (running)
+        return;
+    if (started)
+        throw std::logic_error("CaptureEngine cannot be restarted after stop()");
+
+    started = true;
+    running = true;
+    worker = std::thread(&CaptureEngine::capture, this);
+    BOOST_LOG_TRIVIAL(debug) << "capture engine started with " << buffers << " buffers of " << dma.transferLength() << " bytes";
+}
+
+void CaptureEngine::stop()
+{
+    running = false;
+    if (worker.joinable())
+        worker.join();
+}
+
+ReceivedBlock CaptureEngine::next()
+{
+    Filled block;
+    if (!filled.pop(block))
+        return {};
+
+    return ReceivedBlock(this, block.slot, dma.slotSamples(block.slot, block.bytes));
+}
+
+uint64_t CaptureEngine::blocks() const
+{
+    return blockCount.load(std::memory_order_relaxed);
+}
+
+uint64_t CaptureEngine::overruns() const
+{
+    return overrunCount.load(std::memory_order_relaxed);
+}
+
+uint64_t CaptureEngine::ringDrops() const
+{
+    return ringDropCount.load(std::memory_order_relaxed);
+}
+
+void CaptureEngine::release(std::size_t slot)
+{
+    // Cannot fail, at most buffers slots are ever out
+    freed.push(slot);
+}
+
+void CaptureEngine::capture()
+{
+    std::vector<std::size_t> free;
+    free.reserve(buffers);
+    for (std::size_t slot = buffers; slot-- > 0;)
+        free.push_back(slot);
+
+    std::size_t armed = 0;
+    auto armNext = [&]()
+    {
+        std::size_t slot;
+        while (freed.pop(slot))
+            free.push_back(slot);
+        if (free.empty())
+            return false;
+
+        armed = free.back();
+        free.pop_back();
+        dma.armReceive(armed);
+        return true;
+    };
+
+    bool isArmed = false;
+    while (running.load(std::memory_order_relaxed))
+    {
+        if (!isArmed)
+            isArmed = armNext();
+
+        std::size_t bytes = isArmed ? dma.waitReceiveComplete(CAPTURE_WAIT) : 0;
+        if (bytes == 0)
+        {
+            if (dma.status == Status::ERROR)
+            {
+                BOOST_LOG_TRIVIAL(error) << "capture engine stopped on a DMA error";
+                running = false;
+            }
+            // Waiting on the consumer to release a slot
+            if (!isArmed)
+                std::this_thread::yield();
+            continue;
+        }
+
+        // Re-arm before handing the block over so the DMA never waits on the consumer
+        std::size_t done = armed;
+        isArmed = armNext();
+        if (!isArmed)
+            overrunCount.fetch_add(1, std::memory_order_relaxed);
+
+        blockCount.fetch_add(1, std::memory_order_relaxed);
+        if (ring != nullptr)
+        {
+            // Whole blocks or nothing, so the ring stays frame aligned
+            auto samples = dma.slotSamples(done, bytes);
+            if (ring->capacity() - ring->size() >= samples.size())
+                ring->write(samples);
+            else
+                ringDropCount.fetch_add(samples.size(), std::memory_order_relaxed);
+
+            // Copied out, the slot can go straight back to the DMA
+            free.push_back(done);
+            if (!isArmed)
+                isArmed = armNext();
+            continue;
+        }
+
+        // Cannot fail, at most buffers slots are ever filled
+        filled.push({done, bytes});
+    }
+}
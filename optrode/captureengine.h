@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "AxiStreamDma.h"
+#include "spscQueue.h"
+
+constexpr std::size_t MAX_CAPTURE_BUFFERS = 16;
+
+// Longest the capture thread sleeps on the S2MM channel before checking stop()
+constexpr auto CAPTURE_WAIT = std::chrono::milliseconds(10);
+
+// Keeps the S2MM channel busy by rotating it through several buffer slots. A
+// capture thread re-arms the DMA on the next free slot as soon as one fills,
+// so the hardware fills slot k + 1 while software still reads slot k in place.
+// The thread sleeps on the S2MM interrupt when the DMA has a UIO device.
+//
+// next() and releasing the blocks it returns must happen on one consumer
+// thread. Slots are reused in the order their blocks are released.
+class CaptureEngine : public BlockOwner
+{
+    struct Filled
+    {
+        std::size_t slot;
+        std::size_t bytes;
+    };
+
+    AxiStreamDma &dma;
+    std::size_t buffers;
+
+    SpscQueue<Filled, MAX_CAPTURE_BUFFERS> filled;     // capture thread to consumer
+    SpscQueue<std::size_t, MAX_CAPTURE_BUFFERS> freed; // consumer back to capture thread
+
+    SpscRing<uint32_t> *ring = nullptr;
+
+    std::atomic<bool> running = false;
+    bool started = false;
+    std::atomic<uint64_t> blockCount = 0;
+    std::atomic<uint64_t> overrunCount = 0;
+    std::atomic<uint64_t> ringDropCount = 0;
+    std::thread worker;
+
+    void capture();
+    void release(std::size_t slot) override;
+
+public:
+    CaptureEngine(AxiStreamDma &dma, std::size_t buffers);
+    ~CaptureEngine();
+
+    CaptureEngine(const CaptureEngine &) = delete;
+    CaptureEngine &operator=(const CaptureEngine &) = delete;
+
+    // Copy every block into ring on the capture thread instead of lending it
+    // through next(). The slot is re-armed at once, so the consumer can fall
+    // behind by the whole ring rather than a few DMA slots. Set before start().
+    void attach(SpscRing<uint32_t> &ring);
+
+    // An engine runs once. After stop() blocks may still be lent out and the
+    // S2MM channel left armed on a slot, so start() throws std::logic_error
+    // rather than hand every slot back to the DMA.
+    void start();
+    void stop();
+
+    // Oldest filled block, empty if none has completed yet
+    ReceivedBlock next();
+
+    // Blocks captured so far
+    uint64_t blocks() const;
+
+    // Times a block completed with no free slot to re-arm, the stream is
+    // stalled until the consumer releases one and upstream samples may be lost
+    uint64_t overruns() const;
+
+    // Samples lost because an attached ring was full, whole blocks at a time
+    uint64_t ringDrops() const;
+};
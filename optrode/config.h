@@ -1,9 +1,18 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+
 #include "board.h"
 
 constexpr auto SERIAL_DEVICE = "/dev/sda1";
 
+// DMA device backend, "devmem" on the board or "sim" to run against the
+// software loopback model, i.e. "sim,latency_us=20,bandwidth_MBps=100,fifo_kb=64".
+// The AXIDMA_DEVICE environment variable overrides it.
+constexpr auto DEVICE_BACKEND = "devmem";
+
 // PL configuration
 constexpr auto pl_unload = "/usr/firmware/pl_unload.sh";
 constexpr auto pl_load_default = "/usr/firmware/pl_load_default.sh";
@@ -15,7 +24,29 @@ constexpr uint32_t mm2s_baddr = 0x0e000000;
 constexpr uint32_t s2mm_baddr = 0x0f000000;
 constexpr uint32_t saxi_asize = 0xFFFF;
 
-constexpr size_t transfer_size_bytes = 4;
+// width of the AXI DMA buffer length registers, 14 bits unless the IP is
+// configured wider
+constexpr std::size_t DMA_LENGTH_REGISTER_BITS = 14;
+
+// bytes moved per DMA programming, must fit the length register
+constexpr size_t transfer_block_bytes = 8192;
+static_assert(transfer_block_bytes < (std::size_t{1} << DMA_LENGTH_REGISTER_BITS), "DMA blocks do not fit the length register");
+
+// S2MM buffers the capture engine rotates through. 4 channels at 64 kS/s fill
+// a block every 8 ms, so 4 buffers leave the consumer about 24 ms of slack.
+constexpr std::size_t CAPTURE_BUFFERS = 4;
+static_assert(CAPTURE_BUFFERS * transfer_block_bytes <= saxi_asize, "Capture buffers do not fit the mapped S2MM memory");
+
+// samples the capture thread can queue for the consumers, a power of two.
+// 4 MiB is about 4 s at 4 channels and 64 kS/s.
+constexpr std::size_t CAPTURE_RING_SAMPLES = 1 << 20;
+
+// UIO devices bound to the DMA mm2s_introut/s2mm_introut interrupts
+// (uio_pdrv_genirq). Waits sleep on these instead of polling the status
+// registers, empty or missing devices fall back to adaptive polling.
+constexpr auto MM2S_IRQ_DEVICE = "";
+constexpr auto S2MM_IRQ_DEVICE = "";
+constexpr auto DMA_WAIT_TIMEOUT = std::chrono::milliseconds(100);
 
 // data collection
 constexpr std::string FILENAME_DATACOLLECTION = "data_coll";
@@ -24,6 +55,13 @@ constexpr auto BIT_DEPTH_DATACOLLECTION = 24U;
 constexpr auto SPS_DATACOLLECTION = 64000U;
 constexpr auto BUFFER_SAVE_SECONDS_DATACOLLECTION = 30U;
 
+// blocks the stimulus may run ahead of the captured response, more hides
+// scheduling jitter at the cost of loopback latency. Past CAPTURE_BUFFERS the
+// extra blocks wait in the FPGA FIFOs.
+constexpr std::size_t PLAYBACK_DEPTH = 4;
+// how long the response may stay silent after the last stimulus block
+constexpr auto PLAYBACK_DRAIN_TIMEOUT = std::chrono::seconds(1);
+
 // recordings
 constexpr std::string FILENAME_ANC = "optrode_record";
 constexpr auto NUM_CHANNELS = 1U;
@@ -42,3 +80,45 @@ constexpr auto RECORD_FILE_INTERVAL = MEM_BYTES / SEGMENT_MEMORY;
 
 static_assert(RECORD_FILE_INTERVAL > 0, "Insufficient memory for recording!");
 constexpr auto SAMPLES_PER_FILE = TOTAL_CHANNELS * SAMPLE_RATE * RECORD_SAVE_INTERVAL_SECONDS * RECORD_FILE_INTERVAL;
+
+// live noise cancellation in the recorder, the cancelled channels are written
+// next to the raw recording as <name>_anc_<n>.wav. Optrode channel n is
+// cancelled against reference channel n, both index the captured frames.
+constexpr bool RECORD_ANC = true;
+constexpr std::array<std::size_t, NUM_CHANNELS> ANC_REFERENCE_CHANNELS = {0};
+constexpr std::array<std::size_t, NUM_CHANNELS> ANC_OPTRODE_CHANNELS = {1};
+static_assert(std::ranges::all_of(ANC_REFERENCE_CHANNELS, [](auto channel) { return channel < TOTAL_CHANNELS; }) &&
+                  std::ranges::all_of(ANC_OPTRODE_CHANNELS, [](auto channel) { return channel < TOTAL_CHANNELS; }),
+              "ANC channels must be recorded");
+
+// filter parameters as tuned offline in lmsDemo
+constexpr std::size_t ANC_TAPS = 1;
+constexpr float ANC_LEAKY_ALPHA = 0.999F;
+constexpr float ANC_STEP_SIZE = 0.0005F;
+constexpr float ANC_STEP_ALPHA = 0.9F;
+constexpr float ANC_STEP_GAMMA = 0.1F;
+
+// frames filtered at a time, 256 is about 26 ms at 10 kS/s. A block must be
+// filtered within this share of its duration, which leaves the rest of the
+// core to capture and the writers.
+constexpr std::size_t ANC_BLOCK_FRAMES = 256;
+constexpr double ANC_DEADLINE_LOAD = 0.5;
+
+// sample pool the WAV writer thread can fall behind by before samples are
+// dropped, allocated once at startup. 32 MiB at 4 channels and 10 kS/s rides
+// out about 200 s of disk stall, at 64 kS/s about 30 s.
+constexpr std::size_t WRITER_POOL_BYTES = MEM_BYTES;
+
+// the cancelled channels are batched into writer blocks of whole ANC blocks,
+// about one DMA block each, with a pool in proportion to their share of the
+// samples. Blocks of a single ANC block would need more than a pool can hold.
+constexpr std::size_t ANC_WRITER_BLOCK_SAMPLES =
+    std::max<std::size_t>(transfer_block_bytes / sizeof(uint32_t) / (ANC_BLOCK_FRAMES * NUM_CHANNELS), 1) * ANC_BLOCK_FRAMES * NUM_CHANNELS;
+constexpr std::size_t ANC_WRITER_POOL_BYTES = WRITER_POOL_BYTES / TOTAL_CHANNELS * NUM_CHANNELS;
+
+// files also rotate on wall time when set, 0 rotates on SAMPLES_PER_FILE only
+constexpr auto RECORD_FILE_SECONDS = std::chrono::seconds(0);
+// written data is synced and dropped from the page cache every this many bytes
+constexpr std::size_t WRITER_SYNC_BYTES = 4 * 1024 * 1024;
+// bypass the page cache, falls back to it on filesystems without O_DIRECT
+constexpr bool WRITER_DIRECT_IO = true;
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <boost/log/trivial.hpp>
+
+#include "datawriter.h"
+
+// Offsets are 64 bit, fallocate, pwrite and posix_fadvise must not truncate them
+static_assert(sizeof(off_t) == 8, "DataWriter needs _FILE_OFFSET_BITS=64");
+
+static uint8_t *allocateAligned(std::size_t bytes)
+{
+    auto *memory = static_cast<uint8_t *>(std::aligned_alloc(STORAGE_ALIGNMENT, bytes));
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+DataWriter::DataWriter(DataWriterConfig config) : config(std::move(config))
+{
+    const auto &format = this->config.format;
+    if (!Audio::isWritable(format) || format.encoding != Audio::SampleEncoding::PCM)
+        throw std::invalid_argument("DataWriter needs a PCM format of 8/16/24/32 bits");
+
+    // At least two blocks, so a full buffer always has a whole block to write
+    bufferBytes = std::max(this->config.bufferBytes, 2 * STORAGE_ALIGNMENT);
+    bufferBytes = (bufferBytes + STORAGE_ALIGNMENT - 1) / STORAGE_ALIGNMENT * STORAGE_ALIGNMENT;
+    buffer.reset(allocateAligned(bufferBytes));
+    firstBlock.reset(allocateAligned(STORAGE_ALIGNMENT));
+
+    open();
+}
+
+DataWriter::~DataWriter()
+{
+    try
+    {
+        close();
+    }
+    catch (const std::exception &e)
+    {
+        BOOST_LOG_TRIVIAL(error) << "failed to close " << filename() << ": " << e.what();
+    }
+}
+
+std::string DataWriter::filename() const
+{
+    return config.name + '_' + std::to_string(fileIndex) + ".wav";
+}
+
+void DataWriter::open()
+{
+    std::string path = filename();
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+    direct = config.direct;
+    fd = ::open(path.c_str(), flags | (direct ? O_DIRECT : 0), 0644);
+    if (fd < 0 && direct && errno == EINVAL)
+    {
+        // tmpfs and some FUSE mounts refuse O_DIRECT
+        BOOST_LOG_TRIVIAL(warning) << "O_DIRECT not supported for " << path << ", using the page cache";
+        direct = false;
+        fd = ::open(path.c_str(), flags, 0644);
+    }
+    if (fd < 0)
+        throw std::runtime_error("Failed to open " + path + ": " + std::strerror(errno));
+
+    // Reserve the whole file up front so the card is not fragmented by many
+    // small extents, KEEP_SIZE leaves the length to the data actually written
+    std::size_t bytesPerFrame = config.format.bytesPerFrame();
+    uint64_t expectedFrames = config.framesPerFile;
+    if (expectedFrames == 0)
+        expectedFrames = static_cast<uint64_t>(config.secondsPerFile.count()) * config.format.sampleRate;
+    if (expectedFrames > 0 && ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(Audio::WAV_HEADER_BYTES + expectedFrames * bytesPerFrame)) != 0)
+        BOOST_LOG_TRIVIAL(debug) << "fallocate " << path << ": " << std::strerror(errno);
+
+    // The header leads the buffer, its sizes are patched on every sync
+    Audio::encodeHeader(config.format, 0, buffer.get());
+    buffered = Audio::WAV_HEADER_BYTES;
+    fileOffset = 0;
+    syncedOffset = 0;
+    frames = 0;
+    opened = std::chrono::steady_clock::now();
+    status = WriterStatus::WRITING;
+
+    BOOST_LOG_TRIVIAL(info) << "writing " << path << (direct ? " with O_DIRECT" : "");
+}
+
+bool DataWriter::rotationDue() const
+{
+    if (config.framesPerFile > 0 && frames >= config.framesPerFile)
+        return true;
+    return config.secondsPerFile.count() > 0 && std::chrono::steady_clock::now() - opened >= config.secondsPerFile;
+}
+
+void DataWriter::rotate()
+{
+    BOOST_LOG_TRIVIAL(info) << "save audiofile " << filename() << " with " << frames << " frames";
+    close();
+    fileIndex++;
+    open();
+}
+
+void DataWriter::write(std::span<const int32_t> samples)
+{
+    if (status != WriterStatus::WRITING)
+        throw std::runtime_error("DataWriter is closed");
+
+    std::size_t channels = config.format.channels;
+    std::size_t bytesPerSample = config.format.bytesPerSample();
+    if (samples.size() % channels != 0)
+        throw std::invalid_argument("DataWriter writes must be whole frames");
+
+    while (!samples.empty())
+    {
+        if (rotationDue())
+            rotate();
+
+        // Up to the end of this file
+        uint64_t count = samples.size() / channels;
+        if (config.framesPerFile > 0)
+            count = std::min(count, config.framesPerFile - frames);
+        auto segment = samples.first(static_cast<std::size_t>(count) * channels);
+        samples = samples.subspan(segment.size());
+        frames += count;
+        totalFrames += count;
+
+        while (!segment.empty())
+        {
+            std::size_t space = (bufferBytes - buffered) / bytesPerSample;
+            std::size_t encode = std::min(space, segment.size());
+            Audio::encodeSamples(config.format, segment.first(encode), buffer.get() + buffered);
+            buffered += encode * bytesPerSample;
+            segment = segment.subspan(encode);
+
+            if (bufferBytes - buffered < bytesPerSample)
+                writeBuffer(false);
+        }
+
+        if (config.syncBytes > 0 && fileOffset - syncedOffset >= config.syncBytes)
+            sync();
+    }
+}
+
+void DataWriter::sync()
+{
+    if (status != WriterStatus::WRITING)
+        return;
+
+    writeBuffer(false);
+    patchHeader();
+    if (::fdatasync(fd) != 0)
+        throw std::runtime_error("fdatasync " + filename() + " failed: " + std::strerror(errno));
+
+    // Written back, so the cached pages only crowd out everything else
+    if (!direct)
+        ::posix_fadvise(fd, static_cast<off_t>(syncedOffset), static_cast<off_t>(fileOffset - syncedOffset), POSIX_FADV_DONTNEED);
+    syncedOffset = fileOffset;
+}
+
+void DataWriter::close()
+{
+    if (fd < 0)
+        return;
+
+    try
+    {
+        // The tail is not a whole block, finish the file through the page cache
+        if (direct && ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) & ~O_DIRECT) != 0)
+            throw std::runtime_error(std::string("Failed to clear O_DIRECT: ") + std::strerror(errno));
+        direct = false;
+
+        writeBuffer(true);
+
+        // Chunks are word aligned, odd data is followed by a pad byte
+        uint8_t pad = 0;
+        if (dataBytes() & 1U)
+        {
+            pwriteAll(&pad, 1, fileOffset);
+            fileOffset++;
+        }
+        patchHeader();
+
+        // Hand back the preallocated space past the end
+        if (::ftruncate(fd, static_cast<off_t>(fileOffset)) != 0 || ::fdatasync(fd) != 0)
+            throw std::runtime_error("Failed to finish " + filename() + ": " + std::strerror(errno));
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+    catch (...)
+    {
+        ::close(fd);
+        fd = -1;
+        status = WriterStatus::STOPPED;
+        throw;
+    }
+
+    ::close(fd);
+    fd = -1;
+    status = WriterStatus::STOPPED;
+}
+
+uint64_t DataWriter::dataBytes() const
+{
+    // Whole frames that have reached the file
+    std::size_t bytesPerFrame = config.format.bytesPerFrame();
+    uint64_t written = fileOffset > Audio::WAV_HEADER_BYTES ? fileOffset - Audio::WAV_HEADER_BYTES : 0;
+    written = std::min(written, frames * bytesPerFrame);
+    return written - written % bytesPerFrame;
+}
+
+void DataWriter::writeBuffer(bool all)
+{
+    // O_DIRECT moves whole blocks, the remainder waits for more samples
+    std::size_t length = all || !direct ? buffered : buffered - buffered % STORAGE_ALIGNMENT;
+    if (length == 0)
+        return;
+
+    pwriteAll(buffer.get(), length, fileOffset);
+    if (fileOffset == 0 && length >= STORAGE_ALIGNMENT)
+        std::memcpy(firstBlock.get(), buffer.get(), STORAGE_ALIGNMENT);
+
+    fileOffset += length;
+    buffered -= length;
+    std::memmove(buffer.get(), buffer.get() + length, buffered);
+}
+
+void DataWriter::patchHeader()
+{
+    if (fileOffset < Audio::WAV_HEADER_BYTES)
+        return;
+
+    if (direct)
+    {
+        // Only whole blocks can be written, rewrite the first one around the header
+        Audio::encodeHeader(config.format, dataBytes(), firstBlock.get());
+        pwriteAll(firstBlock.get(), STORAGE_ALIGNMENT, 0);
+        return;
+    }
+
+    uint8_t header[Audio::WAV_HEADER_BYTES];
+    Audio::encodeHeader(config.format, dataBytes(), header);
+    pwriteAll(header, sizeof(header), 0);
+}
+
+void DataWriter::pwriteAll(const uint8_t *bytes, std::size_t length, uint64_t offset)
+{
+    while (length > 0)
+    {
+        ssize_t count = ::pwrite(fd, bytes, length, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            throw std::runtime_error("Failed to write " + filename() + ": " + std::strerror(errno));
+
+        bytes += count;
+        offset += static_cast<uint64_t>(count);
+        length -= static_cast<std::size_t>(count);
+    }
+}
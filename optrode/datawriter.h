@@ -1,15 +1,100 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <span>
+#include <string>
+
+#include "wav.h"
+
+// storage blocks of the SD card/eMMC, O_DIRECT transfers are multiples of this
+constexpr std::size_t STORAGE_ALIGNMENT = 4096;
+
 enum class WriterStatus
 {
     STOPPED,
     WRITING,
 };
 
+struct DataWriterConfig
+{
+    std::string name; // files are written as name_<n>.wav
+    Audio::WavFormat format;
+    uint64_t framesPerFile = 0;              // 0 never rotates on length
+    std::chrono::seconds secondsPerFile{0};  // 0 never rotates on wall time
+    std::size_t bufferBytes = 1024 * 1024;   // rounded up to STORAGE_ALIGNMENT
+    std::size_t syncBytes = 8 * 1024 * 1024; // fdatasync after this much, 0 only on close
+    bool direct = false;                     // bypass the page cache with O_DIRECT
+};
+
+// Stores interleaved PCM samples to a sequence of WAV files. Each file is
+// preallocated with fallocate and written through one aligned buffer, with
+// O_DIRECT when asked for and supported, so the page cache never holds more
+// than one sync interval. Every sync writes the data out, patches the header
+// and calls fdatasync, bounding what a crash or power cut loses.
 class DataWriter
 {
-    WriterStatus status;
+    WriterStatus status = WriterStatus::STOPPED;
+    DataWriterConfig config;
+
+    std::unique_ptr<uint8_t, decltype(&std::free)> buffer{nullptr, &std::free};
+    std::size_t bufferBytes;
+    std::size_t buffered = 0;
+
+    // copy of the first block on disk, the header is patched in it when direct
+    std::unique_ptr<uint8_t, decltype(&std::free)> firstBlock{nullptr, &std::free};
+
+    int fd = -1;
+    bool direct = false;
+    std::size_t fileIndex = 0;
+    uint64_t fileOffset = 0; // bytes on disk, the buffer follows
+    uint64_t syncedOffset = 0;
+    uint64_t frames = 0;
+    uint64_t totalFrames = 0;
+    std::chrono::steady_clock::time_point opened;
+
+    void open();
+    void rotate();
+    bool rotationDue() const;
+    void writeBuffer(bool all);
+    void patchHeader();
+    void pwriteAll(const uint8_t *bytes, std::size_t length, uint64_t offset);
+    uint64_t dataBytes() const;
 
 public:
-    DataWriter();
+    explicit DataWriter(DataWriterConfig config);
+    ~DataWriter();
+
+    DataWriter(const DataWriter &) = delete;
+    DataWriter &operator=(const DataWriter &) = delete;
+
+    // samples must hold whole interleaved frames, files rotate between frames
+    void write(std::span<const int32_t> samples);
+
+    // Write out what the buffer allows, patch the header and fdatasync
+    void sync();
+
+    // Finish the current file, called by the destructor
+    void close();
+
+    WriterStatus getStatus() const
+    {
+        return status;
+    }
+
+    std::string filename() const;
+
+    // frames in the current file and across all files
+    uint64_t fileFrames() const
+    {
+        return frames;
+    }
+
+    uint64_t writtenFrames() const
+    {
+        return totalFrames;
+    }
 };
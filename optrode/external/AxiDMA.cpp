@@ -32,12 +32,16 @@ AxiDMA::~AxiDMA()
     disableAllTxIrq();
     disableAllRxIrq();
 
-    munmap(dma_hw, UNKNOWN_SIZE);
-    close(fd);
+    if (tx_mem != nullptr)
+        device.UnmapMemory(tx_mem, tx_mem_size);
+    if (rx_mem != nullptr)
+        device.UnmapMemory(rx_mem, rx_mem_size);
+    dma_hw.reset();
 
     isRx = 0;
     isTx = 0;
     isSg = false;
+    isRxRing = false;
     _base_addr = AXIDMA_BASEADDR;
 }
 
@@ -47,6 +51,7 @@ AxiDMA::~AxiDMA()
  *
  * @return > 0 - length of sended data.
  * @return -ERR_DMA_IS_DIRECT - Your AXI DMA is configure in Direct Mode
+ * @return -ERR_DMA_UNINIT    - can't initialize descriptors
  * @return -ERR_DMA_BAD_ALLOC - can't allocate memory for buffer
  * @return -ERR_DMA_HAD_WORK  - AXI DMA is halting
  * @return -ERR_DMA_TX_IRQ    - get error interrupt
@@ -62,16 +67,13 @@ int AxiDMA::Send(const AxiDmaBuffer *buff)
 
         std::lock_guard<std::mutex> lock(tx_mute);
         size_t buff_size = buff->GetSize() * sizeof(uint8_t);
-        auto *txring = new AxiDmaDescriptors(false);
-        txring->InitDescriptors(txring->GetBufferBaseAddr(), buff_size);
+        if (txring->InitDescriptors(txring->GetBufferBaseAddr(), buff_size) != AxiDmaDescriptors::RING_OK)
+            return -ERR_DMA_UNINIT;
 
-        auto *tx_data = (uint8_t *)allocBufferMem(buff_size,
-                                                  txring->GetBufferBaseAddr());
+        auto *tx_data = reserveBufferMem(&tx_mem, &tx_mem_size, buff_size,
+                                         txring->GetBufferBaseAddr());
         if (tx_data == nullptr)
-        {
-            delete txring;
             return -ERR_DMA_BAD_ALLOC;
-        }
         buff->CopyInto(tx_data); // Copy from buff to tx_data
 
         /******* Launch sending *********/
@@ -79,20 +81,12 @@ int AxiDMA::Send(const AxiDmaBuffer *buff)
         startTx();
 
         if (checkTxHalt())
-        {
-            delete txring;
-            munmap(tx_data, buff_size);
             return -ERR_DMA_HALT_WORK;
-        }
         setTxTailDesc(txring->GetTailDescriptorAddr()); // here DMA start sending
 
         int status = waitTxComplete();
         if (status != DMA_OK)
-        {
-            delete txring;
-            munmap(tx_data, buff_size);
             return status;
-        }
 
         /*********************************/
 
@@ -102,9 +96,6 @@ int AxiDMA::Send(const AxiDmaBuffer *buff)
         setTxDefault();
         /*********************************/
 
-        delete txring;
-        munmap(tx_data, buff_size);
-
         return transferred_bytes;
     }
     catch (...)
@@ -132,21 +123,14 @@ int AxiDMA::Send_repeat(const AxiDmaBuffer *buff)
 
     std::lock_guard<std::mutex> lock(tx_mute);
     size_t buff_size = buff->GetSize() * sizeof(uint8_t);
-    auto *txring = new AxiDmaDescriptors(false);
     int status = txring->InitDescriptors(txring->GetBufferBaseAddr(), buff_size);
     if (status != 0)
-    {
-        delete txring;
         return status;
-    }
 
-    auto *tx_data = (uint8_t *)allocBufferMem(buff_size,
-                                              txring->GetBufferBaseAddr());
+    auto *tx_data = reserveBufferMem(&tx_mem, &tx_mem_size, buff_size,
+                                     txring->GetBufferBaseAddr());
     if (tx_data == nullptr)
-    {
-        delete txring;
         return -ERR_DMA_BAD_ALLOC;
-    }
     buff->CopyInto(tx_data); // Copy from buff to tx_data
 
     /******* Launch sending *********/
@@ -157,28 +141,19 @@ int AxiDMA::Send_repeat(const AxiDmaBuffer *buff)
     }
 
     if (checkTxHalt())
-    {
-        delete txring;
-        munmap(tx_data, buff_size);
         return -ERR_DMA_HALT_WORK;
-    }
     setTxTailDesc(txring->GetTailDescriptorAddr()); // here DMA start sending
 
     status = waitTxComplete();
     if (status != DMA_OK)
     {
         setTxDefault();
-
-        delete txring;
-        munmap(tx_data, buff_size);
         return status;
     }
     /*********************************/
 
     int transferred_bytes = (int)txring->ProcessDescriptors(true);
 
-    delete txring;
-    munmap(tx_data, buff_size);
     return transferred_bytes;
 }
 
@@ -189,6 +164,8 @@ int AxiDMA::Send_repeat(const AxiDmaBuffer *buff)
  *
  * @return > 0 - length of received data
  * @return -ERR_DMA_IS_DIRECT - Your AXI DMA is configure in Direct Mode
+ * @return -ERR_DMA_ALR_WORK  - S2MM is running continuously (see @StartRecvRing())
+ * @return -ERR_DMA_UNINIT    - can't initialize descriptors
  * @return -ERR_DMA_BAD_ALLOC - can't allocate memory for buffer
  * @return -ERR_DMA_HAD_WORK  - AXI DMA is halting
  * @return -ERR_DMA_RX_IRQ    - get error interrupt
@@ -202,35 +179,27 @@ int AxiDMA::Recv(AxiDmaBuffer *buff, size_t size)
             return -ERR_DMA_IS_DIRECT;
 
         std::lock_guard<std::mutex> lock(rx_mute);
-        auto *rxring = new AxiDmaDescriptors(true);
-        auto *rx_data = (uint8_t *)allocBufferMem(size, rxring->GetBufferBaseAddr());
+        if (isRxRing)
+            return -ERR_DMA_ALR_WORK;
+
+        auto *rx_data = reserveBufferMem(&rx_mem, &rx_mem_size, size,
+                                         rxring->GetBufferBaseAddr());
         if (rx_data == nullptr)
-        {
-            delete rxring;
             return -ERR_DMA_BAD_ALLOC;
-        }
-        memset(rx_data, 0x00, size);
-        rxring->InitDescriptors(rxring->GetBufferBaseAddr(), size);
+        if (rxring->InitDescriptors(rxring->GetBufferBaseAddr(), size) != AxiDmaDescriptors::RING_OK)
+            return -ERR_DMA_UNINIT;
 
         /******* Launch receiving *********/
         setRxCurDesc(rxring->GetHeadDescriptorAddr());
         startRx();
 
         if (checkRxHalt())
-        {
-            delete rxring;
-            munmap(rx_data, size);
             return -ERR_DMA_HALT_WORK;
-        }
         setRxTailDesc(rxring->GetTailDescriptorAddr()); // here DMA start receive
 
         int status = waitRxComplete();
         if (status != DMA_OK)
-        {
-            delete rxring;
-            munmap(rx_data, size);
             return status;
-        }
         /*********************************/
 
         auto transferred_bytes = rxring->ProcessDescriptors(false);
@@ -240,9 +209,6 @@ int AxiDMA::Recv(AxiDmaBuffer *buff, size_t size)
         setRxDefault();
         /*********************************/
 
-        delete rxring;
-        munmap(rx_data, size);
-
         return (int)transferred_bytes;
     }
     catch (...)
@@ -251,6 +217,231 @@ int AxiDMA::Recv(AxiDmaBuffer *buff, size_t size)
     }
 }
 
+/**
+ * @brief Start receiving continuously into a ring of descriptors
+ * @param[in] ring_size      - the size of the ring buffer (in bytes)
+ * @param[in] bytes_per_desc - the size of data received by one descriptor, i.e.
+ *   the block handed back by @RecvRing()
+ *
+ * @return  DMA_OK            - S2MM channel is running
+ * @return -ERR_DMA_IS_DIRECT - Your AXI DMA is configure in Direct Mode
+ * @return -ERR_DMA_ALR_WORK  - S2MM channel already run
+ * @return -ERR_DMA_UNINIT    - can't initialize descriptors
+ * @return -ERR_DMA_BAD_ALLOC - can't allocate memory for buffer
+ * @return -ERR_DMA_HAD_WORK  - AXI DMA is halting
+ * @note The chain and buffer are set up once here. The channel then keeps
+ *   filling descriptors up to the tail, @RecvRing() reclaims completed ones and
+ *   moves the tail past them. If software falls a whole ring behind, the
+ *   channel stalls at the tail instead of overwriting unread data.
+ */
+int AxiDMA::StartRecvRing(size_t ring_size, uint32_t bytes_per_desc)
+{
+    if (!isSg)
+        return -ERR_DMA_IS_DIRECT;
+
+    std::lock_guard<std::mutex> lock(rx_mute);
+    if (isRxRing || isRxRun())
+        return -ERR_DMA_ALR_WORK;
+
+    rxring->SetBytesPerDesc(bytes_per_desc);
+    if (rxring->InitDescriptors(rxring->GetBufferBaseAddr(), ring_size) != AxiDmaDescriptors::RING_OK)
+    {
+        rxring->SetBytesPerDesc(0);
+        return -ERR_DMA_UNINIT;
+    }
+
+    if (reserveBufferMem(&rx_mem, &rx_mem_size, ring_size, rxring->GetBufferBaseAddr()) == nullptr)
+    {
+        rxring->SetBytesPerDesc(0);
+        return -ERR_DMA_BAD_ALLOC;
+    }
+
+    setRxCurDesc(rxring->GetHeadDescriptorAddr());
+    startRx();
+
+    if (checkRxHalt())
+    {
+        setRxDefault();
+        rxring->SetBytesPerDesc(0);
+        return -ERR_DMA_HALT_WORK;
+    }
+    setRxTailDesc(rxring->GetTailDescriptorAddr()); // whole ring belongs to DMA
+
+    rx_released.assign(rxring->GetCountDescriptors(), false);
+    rx_release_index = 0;
+    isRxRing = true;
+    return DMA_OK;
+}
+
+/**
+ * @brief Take every block completed on the receive ring
+ * @param[out] buff - buffer to which received data is appended
+ *
+ * @return > 0 - length of received data
+ * @return 0   - the interrupt came from a block that was already taken
+ * @return -ERR_DMA_IS_DIRECT  - Your AXI DMA is configure in Direct Mode
+ * @return -ERR_DMA_UNINIT     - ring isn't started (see @StartRecvRing())
+ * @return -ERR_DMA_RX_IRQ     - get error interrupt
+ * @return -ERR_DMA_RX_TIMEOUT - no block was completed in time
+ * @note Waits for an interrupt only if no block is completed yet. Blocks are
+ *   copied into @buff and given back to the channel without stopping it.
+ */
+int AxiDMA::RecvRing(AxiDmaBuffer *buff)
+{
+    if (!isSg)
+        return -ERR_DMA_IS_DIRECT;
+
+    std::lock_guard<std::mutex> lock(rx_mute);
+    if (!isRxRing)
+        return -ERR_DMA_UNINIT;
+
+    size_t offset = 0;
+    int index = 0;
+    int length = takeRxBlock(&offset, &index);
+    if (length < 0)
+        return length;
+
+    size_t received = 0;
+    while (length > 0)
+    {
+        buff->CopyFrom(rx_mem + offset, length);
+        received += length;
+        giveBackRxBlock(index);
+        length = (int)rxring->ReclaimDescriptor(&offset, &index);
+    }
+
+    return (int)received;
+}
+
+/**
+ * @brief Lend the next completed block of the receive ring without copying it
+ * @param[out] block - block which is set to the received data
+ *
+ * @return > 0 - length of received data
+ * @return 0   - the interrupt came from a block that was already taken
+ * @return -ERR_DMA_IS_DIRECT  - Your AXI DMA is configure in Direct Mode
+ * @return -ERR_DMA_UNINIT     - ring isn't started (see @StartRecvRing())
+ * @return -ERR_DMA_RX_IRQ     - get error interrupt
+ * @return -ERR_DMA_RX_TIMEOUT - no block was completed in time
+ * @note Data is read in place from DMA memory. Whatever @block held before is
+ *   released first. The DMA can't refill the block's descriptor until it is
+ *   released, so holding blocks eventually stalls the channel. Blocks may be
+ *   released in any order, they are given back to the DMA in ring order.
+ */
+int AxiDMA::RecvBlock(AxiDmaBlock *block)
+{
+    if (!isSg)
+        return -ERR_DMA_IS_DIRECT;
+
+    block->Release();
+
+    std::lock_guard<std::mutex> lock(rx_mute);
+    if (!isRxRing)
+        return -ERR_DMA_UNINIT;
+
+    size_t offset = 0;
+    int index = 0;
+    int length = takeRxBlock(&offset, &index);
+    if (length <= 0)
+        return length;
+
+    *block = AxiDmaBlock(this, index, rx_mem + offset, size_t(length));
+    return length;
+}
+
+/**
+ * @brief Stop receiving on the ring
+ * @param none
+ *
+ * @return DMA_OK - S2MM channel is stopped and set by default
+ * @note Data completed but not taken by @RecvRing() is dropped. The chain and
+ *   buffer stay mapped for the next transfer. Blocks lent by @RecvBlock()
+ *   should be released before the ring is started again.
+ */
+int AxiDMA::StopRecvRing()
+{
+    std::lock_guard<std::mutex> lock(rx_mute);
+    if (!isRxRing)
+        return DMA_OK;
+
+    setRxDefault();
+    rxring->SetBytesPerDesc(0);
+    isRxRing = false;
+
+    return DMA_OK;
+}
+
+/**
+ * @brief Give a block lent by @RecvBlock() back to the receive ring
+ * @param[in] index - position of the block's descriptor in the ring
+ *
+ * @return none
+ */
+void AxiDMA::releaseRxBlock(int index)
+{
+    std::lock_guard<std::mutex> lock(rx_mute);
+    giveBackRxBlock(index);
+}
+
+/**
+ * @brief Mark block as released and move the tail past every released block
+ *   at the front of the ring
+ * @param[in] index - position of the block's descriptor in the ring
+ *
+ * @return none
+ * @note rx_mute must be held
+ */
+void AxiDMA::giveBackRxBlock(int index)
+{
+    if (!isRxRing || index < 0 || size_t(index) >= rx_released.size())
+        return;
+
+    rx_released[index] = true;
+
+    int tail = -1;
+    while (rx_released[rx_release_index])
+    {
+        rx_released[rx_release_index] = false;
+        tail = rx_release_index;
+        rx_release_index = (rx_release_index + 1) % int(rx_released.size());
+    }
+
+    if (tail >= 0)
+        setRxTailDesc(rxring->GetDescriptorAddr(tail)); // give blocks back to DMA
+}
+
+/**
+ * @brief Reclaim the next completed block of the receive ring, wait for it if
+ *   it isn't completed yet
+ * @param[out] offset - offset of the block's data in the ring buffer
+ * @param[out] index  - position of the block's descriptor in the ring
+ *
+ * @return > 0 - length of the block
+ * @return 0   - the interrupt came from a block that was already taken
+ * @return -ERR_DMA_RX_IRQ     - get error interrupt
+ * @return -ERR_DMA_RX_TIMEOUT - no block was completed in time
+ * @note rx_mute must be held
+ */
+int AxiDMA::takeRxBlock(size_t *offset, int *index)
+{
+    size_t length = rxring->ReclaimDescriptor(offset, index);
+    if (length == 0)
+    {
+        int status = waitRxComplete();
+        if (status != DMA_OK)
+            return status;
+        length = rxring->ReclaimDescriptor(offset, index);
+    }
+    else
+    {
+        uint32_t irq = getRxIRQ(); // acknowledge interrupts of blocks taken here
+        if (irq != 0 && ackRxIRQ(irq) != DMA_OK)
+            return -ERR_DMA_RX_IRQ;
+    }
+
+    return (int)length;
+}
+
 /**
  * @brief Two-way transfer data via AXI DMA
  * @param[in]  tx     - buffer with data for sending
@@ -259,6 +450,7 @@ int AxiDMA::Recv(AxiDmaBuffer *buff, size_t size)
  *
  * @return > 0 - length of received data
  * @return -ERR_DMA_IS_DIRECT - Your AXI DMA is configure in Direct Mode
+ * @return -ERR_DMA_ALR_WORK  - S2MM is running continuously (see @StartRecvRing())
  * @return -ERR_DMA_BAD_ALLOC - can't allocate memory for buffer
  * @return -ERR_DMA_HAD_WORK  - AXI DMA is halting
  * @return -ERR_DMA_TX_IRQ    - get error interrupt from MM2S channel
@@ -274,48 +466,26 @@ int AxiDMA::Transf(const AxiDmaBuffer *tx, AxiDmaBuffer *rx, size_t rx_len)
         if (!isSg)
             return -ERR_DMA_IS_DIRECT;
 
-        std::lock_guard<std::mutex> lock(tx_mute);
+        std::scoped_lock lock(tx_mute, rx_mute);
+        if (isRxRing)
+            return -ERR_DMA_ALR_WORK;
+
         size_t tx_len = tx->GetSize() * sizeof(uint8_t);
-        auto *txring = new AxiDmaDescriptors(false);
-        auto *rxring = new AxiDmaDescriptors(true);
 
-        auto *tx_data = (uint8_t *)allocBufferMem(tx_len, txring->GetBufferBaseAddr());
+        auto *tx_data = reserveBufferMem(&tx_mem, &tx_mem_size, tx_len, txring->GetBufferBaseAddr());
         if (tx_data == nullptr)
-        {
-            delete txring;
-            delete rxring;
             return -ERR_DMA_BAD_ALLOC;
-        }
-        auto *rx_data = (uint8_t *)allocBufferMem(rx_len, rxring->GetBufferBaseAddr());
+        auto *rx_data = reserveBufferMem(&rx_mem, &rx_mem_size, rx_len, rxring->GetBufferBaseAddr());
         if (rx_data == nullptr)
-        {
-            delete txring;
-            delete rxring;
-            munmap(tx_data, tx_len);
             return -ERR_DMA_BAD_ALLOC;
-        }
 
-        memset(tx_data, 0x00, tx_len);
-        memset(rx_data, 0x00, rx_len);
         tx->CopyInto(tx_data);
 
         if (txring->InitDescriptors(txring->GetBufferBaseAddr(), tx_len) != AxiDmaDescriptors::RING_OK)
-        {
-            delete txring;
-            delete rxring;
-            munmap(tx_data, tx_len);
-            munmap(rx_data, rx_len);
             return -ERR_DMA_UNINIT;
-        }
 
         if (rxring->InitDescriptors(rxring->GetBufferBaseAddr(), rx_len) != AxiDmaDescriptors::RING_OK)
-        {
-            delete txring;
-            delete rxring;
-            munmap(tx_data, tx_len);
-            munmap(rx_data, rx_len);
             return -ERR_DMA_UNINIT;
-        }
 
         /******* Launch transfering *********/
         setTxCurDesc(txring->GetHeadDescriptorAddr());
@@ -324,21 +494,9 @@ int AxiDMA::Transf(const AxiDmaBuffer *tx, AxiDmaBuffer *rx, size_t rx_len)
         startRx();
 
         if (checkTxHalt())
-        {
-            delete txring;
-            delete rxring;
-            munmap(tx_data, tx_len);
-            munmap(rx_data, rx_len);
             return -ERR_DMA_HALT_WORK;
-        }
         if (checkRxHalt())
-        {
-            delete txring;
-            delete rxring;
-            munmap(tx_data, tx_len);
-            munmap(rx_data, rx_len);
             return -ERR_DMA_HALT_WORK;
-        }
 
         setRxTailDesc(rxring->GetTailDescriptorAddr());
         setTxTailDesc(txring->GetTailDescriptorAddr());
@@ -347,10 +505,6 @@ int AxiDMA::Transf(const AxiDmaBuffer *tx, AxiDmaBuffer *rx, size_t rx_len)
         if (status != DMA_OK)
         {
             resetChannels();
-            delete txring;
-            delete rxring;
-            munmap(tx_data, tx_len);
-            munmap(rx_data, rx_len);
             return status;
         }
 
@@ -358,10 +512,6 @@ int AxiDMA::Transf(const AxiDmaBuffer *tx, AxiDmaBuffer *rx, size_t rx_len)
         if (status != DMA_OK)
         {
             resetChannels();
-            delete txring;
-            delete rxring;
-            munmap(tx_data, tx_len);
-            munmap(rx_data, rx_len);
             return status;
         }
         /*********************************/
@@ -380,11 +530,7 @@ int AxiDMA::Transf(const AxiDmaBuffer *tx, AxiDmaBuffer *rx, size_t rx_len)
         setRxThreshold(1);
         /***********************************/
 
-        rx->CopyFrom(rx_data, rx_len);
-        delete txring;
-        delete rxring;
-        munmap(tx_data, tx_len);
-        munmap(rx_data, rx_len);
+        rx->CopyFrom(rx_data, transferred_bytes);
 
         return transferred_bytes;
     }
@@ -552,6 +698,26 @@ bool AxiDMA::IsSg()
     return isSg;
 }
 
+/**
+ * @brief Choose how the chosen channel waits for its interrupts
+ * @param[in] way        - the way of transfer: true - RX; false - TX
+ * @param[in] completion - i.e. IrqCompletion on the channel's UIO device
+ *   (see @MakeCompletion()), nullptr restores polling
+ *
+ * @return none
+ * @note Not thread safe against a transfer on the same channel
+ */
+void AxiDMA::SetCompletion(bool way, std::unique_ptr<Completion> completion)
+{
+    if (!completion)
+        completion = std::make_unique<PollingCompletion>();
+
+    if (way)
+        rx_completion = std::move(completion);
+    else
+        tx_completion = std::move(completion);
+}
+
 /**
  * @brief Send data via AXI DMA which configure in Direct Mode
  * @param[in] buff - buffer with data for sending
@@ -580,7 +746,7 @@ int AxiDMA::DirectSend(const AxiDmaBuffer *buff)
         startTx();
         if (checkTxHalt())
         {
-            munmap(tx_data, buff_size);
+            device.UnmapMemory(tx_data, buff_size);
             return -ERR_DMA_HALT_WORK;
         }
 
@@ -593,17 +759,17 @@ int AxiDMA::DirectSend(const AxiDmaBuffer *buff)
         int status = waitTxDirectComplete();
         if (status != DMA_OK)
         {
-            munmap(tx_data, buff_size);
+            device.UnmapMemory(tx_data, buff_size);
             return status;
         }
         status = waitTxComplete();
         if (status != DMA_OK)
         {
-            munmap(tx_data, buff_size);
+            device.UnmapMemory(tx_data, buff_size);
             return status;
         }
 
-        munmap(tx_data, buff_size);
+        device.UnmapMemory(tx_data, buff_size);
         return getTxLength();
     }
     catch (...)
@@ -644,7 +810,7 @@ int AxiDMA::DirectRecv(AxiDmaBuffer *buff, size_t size)
             {
                 uint32_t transferred_len = getRxLength();
                 buff->CopyFrom(rx_data, transferred_len);
-                munmap(rx_data, size);
+                device.UnmapMemory(rx_data, size);
 
                 return transferred_len;
             }
@@ -653,7 +819,7 @@ int AxiDMA::DirectRecv(AxiDmaBuffer *buff, size_t size)
         startRx();
         if (checkRxHalt())
         {
-            munmap(rx_data, size);
+            device.UnmapMemory(rx_data, size);
             return -ERR_DMA_HALT_WORK;
         }
         setDestinationAddress(RX_BUFFER_BASE);
@@ -667,14 +833,14 @@ int AxiDMA::DirectRecv(AxiDmaBuffer *buff, size_t size)
         status = waitRxComplete();
         if (status != DMA_OK)
         {
-            munmap(rx_data, size);
+            device.UnmapMemory(rx_data, size);
             return status;
         }
 
         uint32_t transferred_len = getRxLength();
 
         buff->CopyFrom(rx_data, transferred_len);
-        munmap(rx_data, size);
+        device.UnmapMemory(rx_data, size);
 
         return transferred_len;
     }
@@ -777,9 +943,9 @@ uint32_t AxiDMA::GetStatus(bool way)
 uint32_t AxiDMA::GetCurrDesc(bool way)
 {
     if (way)
-        return dma_hw->s2mm_curdesc;
+        return dma_hw->Read(offsetof(dma_device_t, s2mm_curdesc));
     else
-        return dma_hw->mm2s_curdesc;
+        return dma_hw->Read(offsetof(dma_device_t, mm2s_curdesc));
 }
 
 /**
@@ -792,9 +958,9 @@ uint32_t AxiDMA::GetCurrDesc(bool way)
 uint32_t AxiDMA::GetTailDesc(bool way)
 {
     if (way)
-        return dma_hw->s2mm_taildesc;
+        return dma_hw->Read(offsetof(dma_device_t, s2mm_taildesc));
     else
-        return dma_hw->mm2s_taildesc;
+        return dma_hw->Read(offsetof(dma_device_t, mm2s_taildesc));
 }
 
 /**
@@ -802,8 +968,7 @@ uint32_t AxiDMA::GetTailDesc(bool way)
  * @param none
  *
  * @return  DMA_OK           - initialization was successful
- * @return -ERR_DMA_OPEN_FD  - can't get access to /dev/mem
- * @return -ERR_DMA_DEV_MAP  - can't mmap to /dev/mem
+ * @return -ERR_DMA_DEV_MAP  - can't map the registers
  * @return -ERR_DMA_RESET_TX - can't reset Tx channel
  * @return -ERR_DMA_RESET_RX - can't reset Rx channel
  * @return -ERR_DMA_HAD_WORK - AXI DMA already run
@@ -866,29 +1031,32 @@ int AxiDMA::run()
 }
 
 /**
- * @brief Memory map of AXI DMA with dma_hw structure
+ * @brief Map registers of AXI DMA from the device backend (see @GetDeviceBackend())
  * @param none
  *
  * @return  DMA_OK          - mmap was successful
- * @return -ERR_DMA_OPEN_FD - can't open /dev/mem
- * @return -ERR_DMA_DEV_MAP - can't mmap to /dev/mem
+ * @return -ERR_DMA_DEV_MAP - can't map the registers
+ * @note Channels of a backend with interrupt fds (the simulated device) wait
+ *   on them instead of polling
  */
 int AxiDMA::initialization()
 {
-    fd = open("/dev/mem", O_RDWR | O_SYNC);
-    if (fd < 0)
-        return -ERR_DMA_OPEN_FD;
-
-    dma_hw = (dma_device_t *)mmap(nullptr, UNKNOWN_SIZE, PROT_READ | PROT_WRITE,
-                                  MAP_SHARED, fd, _base_addr);
-    if (dma_hw == MAP_FAILED)
+    dma_hw = device.MapRegisters(_base_addr, UNKNOWN_SIZE);
+    if (!dma_hw)
         return -ERR_DMA_DEV_MAP;
 
-    if (hasRx(dma_hw))
+    for (bool way : {false, true})
+    {
+        int irq_fd = device.GetIrqFd(_base_addr, way);
+        if (irq_fd >= 0)
+            SetCompletion(way, std::make_unique<IrqCompletion>(irq_fd, false));
+    }
+
+    if (hasRx(dma_hw.get()))
         isRx = 1;
-    if (hasTx(dma_hw))
+    if (hasTx(dma_hw.get()))
         isTx = 1;
-    if (hasSg(dma_hw))
+    if (hasSg(dma_hw.get()))
         isSg = true;
 
     return DMA_OK;
@@ -1032,7 +1200,7 @@ inline bool AxiDMA::isRxReset()
  */
 inline uint32_t AxiDMA::getTxControl()
 {
-    return dma_hw->mm2s_dmacr;
+    return dma_hw->Read(offsetof(dma_device_t, mm2s_dmacr));
 }
 
 /**
@@ -1043,7 +1211,7 @@ inline uint32_t AxiDMA::getTxControl()
  */
 inline uint32_t AxiDMA::getTxStatus()
 {
-    return dma_hw->mm2s_dmasr;
+    return dma_hw->Read(offsetof(dma_device_t, mm2s_dmasr));
 }
 
 /**
@@ -1054,7 +1222,7 @@ inline uint32_t AxiDMA::getTxStatus()
  */
 inline uint32_t AxiDMA::getRxControl()
 {
-    return dma_hw->s2mm_dmacr;
+    return dma_hw->Read(offsetof(dma_device_t, s2mm_dmacr));
 }
 
 /**
@@ -1065,7 +1233,7 @@ inline uint32_t AxiDMA::getRxControl()
  */
 inline uint32_t AxiDMA::getRxStatus()
 {
-    return dma_hw->s2mm_dmasr;
+    return dma_hw->Read(offsetof(dma_device_t, s2mm_dmasr));
 }
 
 /**
@@ -1076,7 +1244,7 @@ inline uint32_t AxiDMA::getRxStatus()
  */
 inline void AxiDMA::setTxControl(uint32_t control_reg)
 {
-    dma_hw->mm2s_dmacr = control_reg;
+    dma_hw->Write(offsetof(dma_device_t, mm2s_dmacr), control_reg);
 }
 
 /**
@@ -1087,7 +1255,7 @@ inline void AxiDMA::setTxControl(uint32_t control_reg)
  */
 inline void AxiDMA::setTxStatus(uint32_t status_reg)
 {
-    dma_hw->mm2s_dmasr = status_reg;
+    dma_hw->Write(offsetof(dma_device_t, mm2s_dmasr), status_reg);
 }
 
 /**
@@ -1098,7 +1266,7 @@ inline void AxiDMA::setTxStatus(uint32_t status_reg)
  */
 inline void AxiDMA::setTxCurDesc(uint32_t curr_desc)
 {
-    dma_hw->mm2s_curdesc = curr_desc;
+    dma_hw->Write(offsetof(dma_device_t, mm2s_curdesc), curr_desc);
 }
 
 /**
@@ -1109,7 +1277,7 @@ inline void AxiDMA::setTxCurDesc(uint32_t curr_desc)
  */
 inline void AxiDMA::setTxTailDesc(uint32_t tail_desc)
 {
-    dma_hw->mm2s_taildesc = tail_desc;
+    dma_hw->Write(offsetof(dma_device_t, mm2s_taildesc), tail_desc);
 }
 
 /**
@@ -1120,7 +1288,7 @@ inline void AxiDMA::setTxTailDesc(uint32_t tail_desc)
  */
 inline void AxiDMA::setRxControl(uint32_t control_reg)
 {
-    dma_hw->s2mm_dmacr = control_reg;
+    dma_hw->Write(offsetof(dma_device_t, s2mm_dmacr), control_reg);
 }
 
 /**
@@ -1131,7 +1299,7 @@ inline void AxiDMA::setRxControl(uint32_t control_reg)
  */
 inline void AxiDMA::setRxStatus(uint32_t status_reg)
 {
-    dma_hw->s2mm_dmasr = status_reg;
+    dma_hw->Write(offsetof(dma_device_t, s2mm_dmasr), status_reg);
 }
 
 /**
@@ -1142,7 +1310,7 @@ inline void AxiDMA::setRxStatus(uint32_t status_reg)
  */
 inline void AxiDMA::setRxCurDesc(uint32_t curr_desc)
 {
-    dma_hw->s2mm_curdesc = curr_desc;
+    dma_hw->Write(offsetof(dma_device_t, s2mm_curdesc), curr_desc);
 }
 
 /**
@@ -1153,7 +1321,7 @@ inline void AxiDMA::setRxCurDesc(uint32_t curr_desc)
  */
 inline void AxiDMA::setRxTailDesc(uint32_t tail_desc)
 {
-    dma_hw->s2mm_taildesc = tail_desc;
+    dma_hw->Write(offsetof(dma_device_t, s2mm_taildesc), tail_desc);
 }
 
 /**
@@ -1164,7 +1332,7 @@ inline void AxiDMA::setRxTailDesc(uint32_t tail_desc)
  */
 inline void AxiDMA::setSourceAddress(uint32_t src_addr)
 {
-    dma_hw->mm2s_src_addr = src_addr;
+    dma_hw->Write(offsetof(dma_device_t, mm2s_src_addr), src_addr);
 }
 
 /**
@@ -1175,7 +1343,7 @@ inline void AxiDMA::setSourceAddress(uint32_t src_addr)
  */
 inline void AxiDMA::setDestinationAddress(uint32_t dst_addr)
 {
-    dma_hw->s2mm_dst_addr = dst_addr;
+    dma_hw->Write(offsetof(dma_device_t, s2mm_dst_addr), dst_addr);
 }
 
 /**
@@ -1186,7 +1354,7 @@ inline void AxiDMA::setDestinationAddress(uint32_t dst_addr)
  */
 inline void AxiDMA::setTxLength(uint32_t length)
 {
-    dma_hw->mm2s_length = length;
+    dma_hw->Write(offsetof(dma_device_t, mm2s_length), length);
 }
 
 /**
@@ -1197,7 +1365,7 @@ inline void AxiDMA::setTxLength(uint32_t length)
  */
 inline void AxiDMA::setRxLength(uint32_t length)
 {
-    dma_hw->s2mm_length = length;
+    dma_hw->Write(offsetof(dma_device_t, s2mm_length), length);
 }
 
 /**
@@ -1208,7 +1376,7 @@ inline void AxiDMA::setRxLength(uint32_t length)
  */
 inline uint32_t AxiDMA::getTxLength()
 {
-    return dma_hw->mm2s_length;
+    return dma_hw->Read(offsetof(dma_device_t, mm2s_length));
 }
 
 /**
@@ -1219,7 +1387,7 @@ inline uint32_t AxiDMA::getTxLength()
  */
 inline uint32_t AxiDMA::getRxLength()
 {
-    return dma_hw->s2mm_length;
+    return dma_hw->Read(offsetof(dma_device_t, s2mm_length));
 }
 
 /**
@@ -1347,7 +1515,7 @@ int AxiDMA::setRxThreshold(uint32_t threshold)
  */
 inline bool AxiDMA::isTxWork()
 {
-    return (dma_hw->mm2s_dmasr & DMASR_HALT_MASK) == 0;
+    return (dma_hw->Read(offsetof(dma_device_t, mm2s_dmasr)) & DMASR_HALT_MASK) == 0;
 }
 
 /**
@@ -1359,7 +1527,7 @@ inline bool AxiDMA::isTxWork()
  */
 inline bool AxiDMA::isRxWork()
 {
-    return (dma_hw->s2mm_dmasr & DMASR_HALT_MASK) == 0;
+    return (dma_hw->Read(offsetof(dma_device_t, s2mm_dmasr)) & DMASR_HALT_MASK) == 0;
 }
 
 /**
@@ -1371,7 +1539,7 @@ inline bool AxiDMA::isRxWork()
  */
 inline bool AxiDMA::isTxRun()
 {
-    return (dma_hw->mm2s_dmacr & DMACR_RUN_MASK) != 0;
+    return (dma_hw->Read(offsetof(dma_device_t, mm2s_dmacr)) & DMACR_RUN_MASK) != 0;
 }
 
 /**
@@ -1383,7 +1551,7 @@ inline bool AxiDMA::isTxRun()
  */
 inline bool AxiDMA::isRxRun()
 {
-    return (dma_hw->s2mm_dmacr & DMACR_RUN_MASK) != 0;
+    return (dma_hw->Read(offsetof(dma_device_t, s2mm_dmacr)) & DMACR_RUN_MASK) != 0;
 }
 
 /**
@@ -1504,16 +1672,46 @@ uint32_t AxiDMA::ackRxIRQ(uint32_t irq)
  *
  * @return data    - pointer to allocated memory
  * @return nullptr - if can't allocate memory
- * @note Used mmap to buffer address which write into 0x08 register in DMA descriptor.
- *   After sending/receiving data, you have to deallocate (munmap) this memory.
+ * @note Maps the buffer address which write into 0x08 register in DMA descriptor.
+ *   After sending/receiving data, you have to deallocate (UnmapMemory) this memory.
  */
 void *AxiDMA::allocBufferMem(size_t buff_size, uint32_t buffer_base_address)
 {
-    auto *data = (uint8_t *)mmap(nullptr, buff_size, PROT_READ | PROT_WRITE,
-                                 MAP_SHARED, fd, buffer_base_address);
-    if (data == MAP_FAILED)
+    return device.MapMemory(buffer_base_address, buff_size);
+}
+
+/**
+ * @brief Get mapping of a buffer for DMA data, map it only if the current one is
+ *   too small
+ * @param[in,out] mem                 - current mapping of buffer (nullptr if none)
+ * @param[in,out] mem_size            - size of current mapping (in bytes)
+ * @param[in]     buff_size           - size of data to fit (in bytes)
+ * @param[in]     buffer_base_address - base address of buffer which using for DMA
+ *   descriptors
+ *
+ * @return data    - pointer to mapped memory
+ * @return nullptr - if can't allocate memory
+ * @note Maps at least DESCRIPTORS_BUFF_SIZE, so usual transfers never remap.
+ *   Mapping is released in destructor.
+ */
+uint8_t *AxiDMA::reserveBufferMem(uint8_t **mem, size_t *mem_size, size_t buff_size,
+                                  uint32_t buffer_base_address)
+{
+    if (*mem != nullptr && *mem_size >= buff_size)
+        return *mem;
+
+    if (*mem != nullptr)
+        device.UnmapMemory(*mem, *mem_size);
+    *mem = nullptr;
+    *mem_size = 0;
+
+    size_t map_size = std::max(buff_size, DESCRIPTORS_BUFF_SIZE);
+    auto *data = (uint8_t *)allocBufferMem(map_size, buffer_base_address);
+    if (data == nullptr)
         return nullptr;
 
+    *mem = data;
+    *mem_size = map_size;
     return data;
 }
 
@@ -1564,46 +1762,21 @@ bool AxiDMA::checkRxHalt()
  * @return  DMA_OK             - DMA transaction was complete successfully
  * @return -ERR_DMA_TX_TIMEOUT - timeout of data transfer
  * @return -ERR_DMA_TX_IRQ     - get interrupt of error
- * @note Used std::this_thread::sleep_for for delay.
+ * @note Sleeps as tx_completion decides, see @SetCompletion().
  */
 inline int AxiDMA::waitTxComplete()
 {
-    /*size_t timeout_10s = 10000000; // 10 second (-1)
-    volatile uint32_t tx_irq = getTxIRQ();
-    while (!tx_irq && (timeout_10s > 0)) { // search interrupt register
-        tx_irq = getTxIRQ();
-        //if (tx_irq == 0)
-         //   std::this_thread::sleep_for(std::chrono::microseconds(10));
-        timeout_10s -= 1;
-    }
-
-    int status = ackTxIRQ(tx_irq);
-    if ((status != DMA_OK) && (timeout_10s > 0)) {
-        printf("tx_irq_err: %x | %d s\r\n", status, timeout_10s); // debug
-        return -ERR_DMA_TX_IRQ;
-    } else if (timeout_10s <= 0 && (tx_irq != DMASR_IOCIRQ_MASK))
-        return -ERR_DMA_TX_TIMEOUT;
+    constexpr std::chrono::seconds wait_time{3};
+    uint32_t tx_irq = 0;
 
-    return DMA_OK;*/
-    constexpr int wait_time = 3;             // 10;
-    constexpr uint64_t second = 1000000;     // 1 second in microseconds
-    size_t timeout_10s = second * wait_time; // 10 second (-1)
-    volatile uint32_t tx_irq = getTxIRQ();
-
-    for (auto i = timeout_10s; i > 0; i -= 100)
-    {
-        tx_irq = getTxIRQ();
-        if (tx_irq != 0)
-            break;
-        std::this_thread::sleep_for(std::chrono::microseconds(10));
-    }
+    tx_completion->Wait([&]() { return (tx_irq = getTxIRQ()) != 0; }, wait_time);
 
     int status = ackTxIRQ(tx_irq);
     if (status == DMA_OK)
         return DMA_OK;
     else if (status != -ERR_DMA_TX_TIMEOUT)
     {
-        printf("tx_irq_err: %x | %d s\r\n", status, timeout_10s); // debug
+        printf("tx_irq_err: %x\r\n", status); // debug
         return -ERR_DMA_TX_IRQ;
     }
     else
@@ -1617,22 +1790,14 @@ inline int AxiDMA::waitTxComplete()
  * @return  DMA_OK             - DMA transaction was complete successfully
  * @return -ERR_DMA_RX_TIMEOUT - timeout of data transfer
  * @return -ERR_DMA_RX_IRQ     - get interrupt of error
- * @note Used std::this_thread::sleep_for for delay.
+ * @note Sleeps as rx_completion decides, see @SetCompletion().
  */
 inline int AxiDMA::waitRxComplete()
 {
-    constexpr int wait_time = 3;             // 10;
-    constexpr uint64_t second = 1000000;     // 1 second in microseconds
-    size_t timeout_10s = second * wait_time; // 10 second (-1)
-    volatile uint32_t rx_irq = getRxIRQ();
+    constexpr std::chrono::seconds wait_time{3};
+    uint32_t rx_irq = 0;
 
-    for (auto i = timeout_10s; i > 0; i -= 100)
-    {
-        rx_irq = getRxIRQ();
-        if (rx_irq != 0)
-            break;
-        std::this_thread::sleep_for(std::chrono::microseconds(1));
-    }
+    rx_completion->Wait([&]() { return (rx_irq = getRxIRQ()) != 0; }, wait_time);
 
     int status = ackRxIRQ(rx_irq);
     if (status == DMA_OK)
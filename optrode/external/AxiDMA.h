@@ -5,16 +5,23 @@
 #ifndef AXIDMA_API_AXIDMA_H
 #define AXIDMA_API_AXIDMA_H
 
+#include <algorithm>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <stdexcept>
 #include <thread>
 #include <unistd.h>
+#include <memory>
 #include <mutex>
+#include <vector>
+#include "AxiDmaBlock.h"
 #include "AxiDmaBuffer.h"
 #include "AxiDmaDescriptors.h"
+#include "Completion.h"
+#include "DeviceBackend.h"
 
 /**
  * @class Used for transferring data via AXI DMA from userspace
@@ -55,6 +62,11 @@ public:
 
     int Send_repeat(const AxiDmaBuffer *buff);
 
+    int StartRecvRing(size_t ring_size, uint32_t bytes_per_desc);
+    int RecvRing(AxiDmaBuffer *buff);
+    int RecvBlock(AxiDmaBlock *block);
+    int StopRecvRing();
+
     int ManualPrepareTransfer(AxiDmaDescriptors *desc_chain, bool way);
     int ManualStartTransfer(AxiDmaDescriptors *desc_chain, bool way);
     int ManualPollIrq(bool way);
@@ -62,6 +74,7 @@ public:
     void *ManualAllocMemory(size_t buffer_size, uint32_t buffer_base_address);
 
     bool IsSg();
+    void SetCompletion(bool way, std::unique_ptr<Completion> completion);
     /******************************************/
 
     /************** Direct mode ***************/
@@ -159,11 +172,36 @@ private:
      * Software part of AXI DMA
      * Uninitialized dma means no connection between software and hardware parts
      */
-    int fd{0};
+    DeviceBackend &device{GetDeviceBackend()}; // Registers and memory, see @SetDeviceBackend()
     int isRx{0};          // Is exist RX channel
     int isTx{0};          // Is exist TX channel
     bool isSg{false};     // Is Scatter/Gather mode
-    dma_device_t *dma_hw; // Pointer to hardware AXI DMA
+    std::unique_ptr<RegisterBlock> dma_hw; // Registers of hardware AXI DMA (dma_device_t layout)
+
+    /**
+     * Descriptor chains and data buffers are mapped on first use and kept,
+     * every transfer after that only rewrites the descriptors
+     */
+    std::unique_ptr<AxiDmaDescriptors> txring{std::make_unique<AxiDmaDescriptors>(false)};
+    std::unique_ptr<AxiDmaDescriptors> rxring{std::make_unique<AxiDmaDescriptors>(true)};
+    uint8_t *tx_mem{nullptr}; // Mapping of the MM2S data buffer
+    uint8_t *rx_mem{nullptr}; // Mapping of the S2MM data buffer
+    size_t tx_mem_size{0};
+    size_t rx_mem_size{0};
+    bool isRxRing{false}; // S2MM is running continuously on rxring
+    /**
+     * How waitTxComplete()/waitRxComplete() sleep, polling unless a UIO
+     * device is set (see @SetCompletion())
+     */
+    std::unique_ptr<Completion> tx_completion{std::make_unique<PollingCompletion>()};
+    std::unique_ptr<Completion> rx_completion{std::make_unique<PollingCompletion>()};
+    std::vector<bool> rx_released; // Ring blocks released by software, by descriptor
+    int rx_release_index{0};       // Next ring block to give back to DMA
+
+    friend class AxiDmaBlock;
+    void releaseRxBlock(int index);
+    void giveBackRxBlock(int index);
+    int takeRxBlock(size_t *offset, int *index);
 
     int run();
     int initialization();
@@ -228,6 +266,8 @@ private:
     uint32_t ackRxIRQ(uint32_t irq);
 
     void *allocBufferMem(size_t buff_size, uint32_t buffer_base_address);
+    uint8_t *reserveBufferMem(uint8_t **mem, size_t *mem_size, size_t buff_size,
+                              uint32_t buffer_base_address);
     bool checkTxHalt();
     bool checkRxHalt();
 
@@ -238,19 +278,20 @@ private:
     int waitRxDirectComplete();
 
     /****** Check existence of Tx/Rx channels *******/
-    static bool hasTx(dma_device_t *dma_hw)
+    static bool hasTx(RegisterBlock *dma_hw)
     { // check MM2S channel
-        return dma_hw->mm2s_dmacr != 0;
+        return dma_hw->Read(offsetof(dma_device_t, mm2s_dmacr)) != 0;
     }
 
-    static bool hasRx(dma_device_t *dma_hw)
+    static bool hasRx(RegisterBlock *dma_hw)
     { // check S2MM channel
-        return dma_hw->s2mm_dmacr != 0;
+        return dma_hw->Read(offsetof(dma_device_t, s2mm_dmacr)) != 0;
     }
 
-    static bool hasSg(dma_device_t *dma_hw)
+    static bool hasSg(RegisterBlock *dma_hw)
     { // check Scatter/Gather mode
-        return (dma_hw->s2mm_dmasr & DMASR_ISSG_MASK) || (dma_hw->mm2s_dmasr & DMASR_ISSG_MASK);
+        return (dma_hw->Read(offsetof(dma_device_t, s2mm_dmasr)) & DMASR_ISSG_MASK) ||
+               (dma_hw->Read(offsetof(dma_device_t, mm2s_dmasr)) & DMASR_ISSG_MASK);
     }
 };
 
@@ -0,0 +1,87 @@
+#include <utility>
+
+#include "AxiDmaBlock.h"
+#include "AxiDMA.h"
+
+AxiDmaBlock::AxiDmaBlock(AxiDMA *dma, int index, const uint8_t *data, size_t size) noexcept
+    : _dma(dma), _index(index), _data(data), _size(size)
+{
+}
+
+AxiDmaBlock::AxiDmaBlock(AxiDmaBlock &&other) noexcept
+    : _dma(std::exchange(other._dma, nullptr)), _index(std::exchange(other._index, -1)),
+      _data(std::exchange(other._data, nullptr)), _size(std::exchange(other._size, 0))
+{
+}
+
+AxiDmaBlock &AxiDmaBlock::operator=(AxiDmaBlock &&other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        _dma = std::exchange(other._dma, nullptr);
+        _index = std::exchange(other._index, -1);
+        _data = std::exchange(other._data, nullptr);
+        _size = std::exchange(other._size, 0);
+    }
+
+    return *this;
+}
+
+AxiDmaBlock::~AxiDmaBlock()
+{
+    Release();
+}
+
+/**
+ * @brief Get received data
+ * @param none
+ *
+ * @return view of the data in DMA memory, valid until the block is released
+ */
+std::span<const uint8_t> AxiDmaBlock::GetData() const
+{
+    return {_data, _size};
+}
+
+/**
+ * @brief Get size of received data
+ * @param none
+ *
+ * @return size of data (in bytes)
+ */
+size_t AxiDmaBlock::GetSize() const
+{
+    return _size;
+}
+
+/**
+ * @brief Check block holds data
+ * @param none
+ *
+ * @return true  - nothing is lent (default constructed or released)
+ * @return false - block holds received data
+ */
+bool AxiDmaBlock::IsEmpty() const
+{
+    return _dma == nullptr;
+}
+
+/**
+ * @brief Give block back to the DMA receive ring
+ * @param none
+ *
+ * @return none
+ * @note Data mustn't be accessed after release, DMA may overwrite it
+ */
+void AxiDmaBlock::Release()
+{
+    if (_dma == nullptr)
+        return;
+
+    _dma->releaseRxBlock(_index);
+    _dma = nullptr;
+    _index = -1;
+    _data = nullptr;
+    _size = 0;
+}
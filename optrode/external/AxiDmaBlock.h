@@ -0,0 +1,42 @@
+#ifndef AXIDMA_API_AXIDMABLOCK_H
+#define AXIDMA_API_AXIDMABLOCK_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+
+class AxiDMA;
+
+/**
+ * @class Block of received data lent in place from the AXI DMA receive ring.
+ *   The block's descriptor is given back to the DMA when it is released or
+ *   destroyed, so no copy of the data is made.
+ */
+class AxiDmaBlock
+{
+public:
+    AxiDmaBlock() noexcept = default;
+    AxiDmaBlock(AxiDmaBlock &&other) noexcept;
+    AxiDmaBlock &operator=(AxiDmaBlock &&other) noexcept;
+
+    AxiDmaBlock(const AxiDmaBlock &) = delete;
+    AxiDmaBlock &operator=(const AxiDmaBlock &) = delete;
+
+    std::span<const uint8_t> GetData() const;
+    size_t GetSize() const;
+    bool IsEmpty() const;
+    void Release();
+
+    virtual ~AxiDmaBlock();
+
+private:
+    friend class AxiDMA;
+    AxiDmaBlock(AxiDMA *dma, int index, const uint8_t *data, size_t size) noexcept;
+
+    AxiDMA *_dma{nullptr};         // Owner of the ring, nullptr if nothing is lent
+    int _index{-1};                // Position of the block's descriptor in the ring
+    const uint8_t *_data{nullptr};
+    size_t _size{0};
+};
+
+#endif // AXIDMA_API_AXIDMABLOCK_H
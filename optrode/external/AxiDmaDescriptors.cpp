@@ -20,8 +20,8 @@ AxiDmaDescriptors::AxiDmaDescriptors(bool chan)
 
 AxiDmaDescriptors::~AxiDmaDescriptors()
 {
-    munmap(chain_virt_baseaddr, _chain_size);
-    close(fd);
+    if (chain_virt_baseaddr != nullptr)
+        device.UnmapMemory(chain_virt_baseaddr, mapped_size);
     isRx = false;
     _chain_size = 0;
     bytes_per_desc = BD_OPTIMAL_SIZE;
@@ -94,10 +94,11 @@ uint32_t AxiDmaDescriptors::GetBufferBaseAddr()
  * @return  RING_OK     - all descriptors was initialize successfully
  * @return -ERR_BDCNT   - can't calculate count of descriptors
  * @return -ERR_SIZE    - pass not aligned size of data
- * @return -ERR_OPEN_FD - can't get access to /dev/mem
  * @return -ERR_MAP     - can't mmap to SG descriptor
  * @note Calculate count of descriptors by passing @buffer_size.
- *   For @buffer_addr prefer to use @GetBufferBaseAddr().
+ *   For @buffer_addr prefer to use @GetBufferBaseAddr(). The last descriptor
+ *   links back to the head, so the chain can be reused as a ring. Calling it
+ *   again on the same object reuses the mapping of the chain.
  */
 int AxiDmaDescriptors::InitDescriptors(uint32_t buffer_addr, size_t buffer_size)
 {
@@ -117,7 +118,7 @@ int AxiDmaDescriptors::InitDescriptors(uint32_t buffer_addr, size_t buffer_size)
         next_address_phys = getNextAddress(next_address_phys);
 
         setNextDescrAddr(curr_descriptor, next_address_phys);
-        setBufferAddr(curr_descriptor, buffer_addr);
+        setBufferAddr(curr_descriptor, _buffer_addr);
         setStatus(curr_descriptor, 0x00);
         setLength(curr_descriptor, bytes_per_desc);
 
@@ -133,6 +134,8 @@ int AxiDmaDescriptors::InitDescriptors(uint32_t buffer_addr, size_t buffer_size)
     if (!isRx)
         setEof(curr_descriptor);
 
+    reclaim_index = 0;
+    reclaimed_index = -1;
     return RING_OK;
 }
 
@@ -142,15 +145,18 @@ int AxiDmaDescriptors::InitDescriptors(uint32_t buffer_addr, size_t buffer_size)
  *   fields in descriptors; false - clear Control and Status fields in descriptors
  *
  * @return size - count of transmitted bytes
+ * @note Starts from the first descriptor not yet reclaimed, so it can be called
+ *   repeatedly on a running ring. Soft freed descriptors keep their length and
+ *   are ready to be handed back to the hardware.
  */
 size_t AxiDmaDescriptors::ProcessDescriptors(bool soft)
 {
     int proc_descrs = countProcessedDescs();
 
     size_t size = 0;
-    auto *curr_descriptor = (descr_t *)getHeadOfDescriptors();
     for (auto proc_descr_cnt = 0; proc_descr_cnt < proc_descrs; proc_descr_cnt++)
     {
+        auto *curr_descriptor = getDescriptor(reclaim_index);
         if (isSof(curr_descriptor))
             size = getTransferredLen(curr_descriptor);
         else if (isIof(curr_descriptor))
@@ -162,12 +168,69 @@ size_t AxiDmaDescriptors::ProcessDescriptors(bool soft)
             freeDescriptor(curr_descriptor);
         else
             curr_descriptor->status = 0;
-        curr_descriptor = (descr_t *)getNextAddress(curr_descriptor);
+        advanceReclaim();
     }
 
     return size;
 }
 
+/**
+ * @brief Reclaim the next completed descriptor of the ring
+ * @param[out] offset - offset of the descriptor's data from the buffer address
+ *   passed to @InitDescriptors()
+ * @param[out] index  - position of the descriptor in the chain (optional)
+ *
+ * @return > 0 - length of data transferred by the descriptor
+ * @return 0   - the next descriptor isn't completed yet
+ * @note The descriptor keeps its Control field, so after @offset has been read
+ *   it can be given back to the hardware by moving the tail descriptor to
+ *   @GetReclaimedDescriptorAddr().
+ */
+size_t AxiDmaDescriptors::ReclaimDescriptor(size_t *offset, int *index)
+{
+    if (bd_count == 0)
+        return 0;
+
+    auto *curr_descriptor = getDescriptor(reclaim_index);
+    if (!isCompleted(curr_descriptor))
+        return 0;
+
+    size_t length = getTransferredLen(curr_descriptor);
+    *offset = size_t(reclaim_index) * bytes_per_desc;
+    if (index != nullptr)
+        *index = reclaim_index;
+    curr_descriptor->status = 0;
+    advanceReclaim();
+
+    return length;
+}
+
+/**
+ * @brief Get address of the descriptor reclaimed last
+ * @param none
+ *
+ * @return hardware address of the last reclaimed descriptor, the tail of the
+ *   chain if nothing was reclaimed since @InitDescriptors()
+ */
+uint32_t AxiDmaDescriptors::GetReclaimedDescriptorAddr()
+{
+    if (reclaimed_index < 0)
+        return GetTailDescriptorAddr();
+
+    return GetDescriptorAddr(reclaimed_index);
+}
+
+/**
+ * @brief Get address of descriptor by its position in the chain
+ * @param[in] index - position of descriptor, 0 is the head
+ *
+ * @return hardware address of the descriptor
+ */
+uint32_t AxiDmaDescriptors::GetDescriptorAddr(int index)
+{
+    return chain_phys_baseaddr + uint32_t(index) * BD_MIN_ALIGNMENT;
+}
+
 /**
  * @brief Get status register of first descriptor in the chain
  * @param none
@@ -199,7 +262,6 @@ bool AxiDmaDescriptors::IsRx() const
  * @return RING_OK - chain of descriptors is ready
  * @return -ERR_BDCNT   - can't calculate count of descriptors
  * @return -ERR_SIZE    - pass not aligned size of data
- * @return -ERR_OPEN_FD - can't get access to /dev/mem
  * @return -ERR_MAP     - can't mmap to SG descriptor
  */
 int AxiDmaDescriptors::prepareChain(size_t buffer_size)
@@ -282,19 +344,25 @@ int AxiDmaDescriptors::setChainSize(size_t chain_size)
  * @param none
  *
  * @return  RING_OK     - allocate was successful
- * @return -ERR_OPEN_FD - can't get access to /dev/mem
- * @return -ERR_MAP     - can't mmap to descriptor chain
+ * @return -ERR_MAP     - can't map the descriptor chain
+ * @note The mapping is kept and reused while the chain fits in it
  */
 int AxiDmaDescriptors::allocDescriptorMem()
 {
-    fd = open("/dev/mem", O_RDWR | O_SYNC);
-    if (fd < 0)
-        return -ERR_OPEN_FD;
+    if (chain_virt_baseaddr != nullptr && mapped_size >= _chain_size)
+    {
+        clearMemory();
+        return RING_OK;
+    }
+
+    if (chain_virt_baseaddr != nullptr)
+        device.UnmapMemory(chain_virt_baseaddr, mapped_size);
+    mapped_size = 0;
 
-    chain_virt_baseaddr = (uint32_t *)mmap(nullptr, _chain_size, PROT_READ | PROT_WRITE,
-                                           MAP_SHARED, fd, chain_phys_baseaddr);
-    if (chain_virt_baseaddr == MAP_FAILED)
+    chain_virt_baseaddr = (uint32_t *)device.MapMemory(chain_phys_baseaddr, _chain_size);
+    if (chain_virt_baseaddr == nullptr)
         return -ERR_MAP;
+    mapped_size = _chain_size;
 
     clearMemory();
     return RING_OK;
@@ -348,6 +416,20 @@ void *AxiDmaDescriptors::getNextAddress(void *current_descriptor) const
     return reinterpret_cast<void *>(current_addr);
 }
 
+/**
+ * @brief Get pointer to descriptor by its position in the chain
+ * @param[in] index - position of descriptor, 0 is the head
+ *
+ * @return pointer to the descriptor
+ */
+AxiDmaDescriptors::descr_t *AxiDmaDescriptors::getDescriptor(int index) const
+{
+    auto addr = reinterpret_cast<std::uintptr_t>(getHeadOfDescriptors());
+    addr += std::uintptr_t(index) * BD_MIN_ALIGNMENT;
+
+    return reinterpret_cast<descr_t *>(addr);
+}
+
 /**
  * @brief Return tail address of descriptors chain
  * @param[in] headmem_addr - value of head address of descriptors chain
@@ -625,20 +707,34 @@ inline void AxiDmaDescriptors::freeDescriptor(descr_t *curr_descr)
  * @param none
  *
  * @return count of processed (completed) descriptors
+ * @note Counts from the reclaim position and stops after one lap, the chain
+ *   is a ring so a fully completed chain would otherwise never end
  */
 int AxiDmaDescriptors::countProcessedDescs()
 {
     int processed_descrs = 0;
-    auto *curr_descriptor = (descr_t *)getHeadOfDescriptors();
-    while (isCompleted(curr_descriptor))
+    int index = reclaim_index;
+    while (processed_descrs < bd_count && isCompleted(getDescriptor(index)))
     {
         processed_descrs++;
-        curr_descriptor = (descr_t *)getNextAddress(curr_descriptor);
+        index = (index + 1) % bd_count;
     }
 
     return processed_descrs;
 }
 
+/**
+ * @brief Move reclaim position to the next descriptor of the ring
+ * @param none
+ *
+ * @return none
+ */
+inline void AxiDmaDescriptors::advanceReclaim()
+{
+    reclaimed_index = reclaim_index;
+    reclaim_index = (reclaim_index + 1) % bd_count;
+}
+
 /**
  * @brief Show values of descriptors in the chain
  * @param none
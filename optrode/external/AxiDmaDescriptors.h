@@ -14,6 +14,8 @@
 #include <unistd.h>
 #include <cstdint>
 
+#include "DeviceBackend.h"
+
 /**
  * @class Used for working with AXI DMA descriptors
  */
@@ -46,6 +48,9 @@ public:
 
     int InitDescriptors(uint32_t buffer_addr, size_t buffer_size);
     size_t ProcessDescriptors(bool soft);
+    size_t ReclaimDescriptor(size_t *offset, int *index = nullptr);
+    uint32_t GetReclaimedDescriptorAddr();
+    uint32_t GetDescriptorAddr(int index);
 
     uint32_t GetStatus();
     bool IsRx() const;
@@ -84,16 +89,19 @@ private:
     static constexpr uint32_t TX_BASEADDR = 0x0e000000;
     static constexpr uint32_t TX_BUFFER_BASE = 0x04000000;
 
-    int fd{0};
+    DeviceBackend &device{GetDeviceBackend()}; // Memory of the chain, see @SetDeviceBackend()
     size_t remainder_size{0};                 // Size of remainder buffer
     uint32_t bytes_per_desc{BD_OPTIMAL_SIZE}; // Buffer size per descriptor
 
     uint32_t chain_phys_baseaddr;  // Hardware address of DDR
     uint32_t buffer_phys_baseaddr; // The starting address of the data buffer
-    uint32_t *chain_virt_baseaddr; // Virtual address of the beginning of
-                                   // the segment of the chain of descriptors
-    uint32_t _chain_size{0};       // Memory size for storing descriptors
+    uint32_t *chain_virt_baseaddr{nullptr}; // Virtual address of the beginning of
+                                            // the segment of the chain of descriptors
+    uint32_t _chain_size{0};                // Memory size for storing descriptors
+    uint32_t mapped_size{0};                // Memory size currently mapped for the chain
     int bd_count{0};
+    int reclaim_index{0};    // Next descriptor expected to complete
+    int reclaimed_index{-1}; // Last descriptor handed back to software
     bool isRx{false}; // Channel of reception or transmission?
 
     int prepareChain(size_t buffer_size);
@@ -104,6 +112,7 @@ private:
     void clearMemory();
 
     void *getHeadOfDescriptors() const;
+    descr_t *getDescriptor(int index) const;
     uint32_t getNextAddress(uint32_t current_address);
     void *getNextAddress(void *current_descriptor) const;
 
@@ -136,6 +145,7 @@ private:
 
     void freeDescriptor(descr_t *curr_descr);
     int countProcessedDescs();
+    void advanceReclaim();
 };
 
 #endif // AXIDMA_API_AXIDMADESCRIPTOR_H
@@ -0,0 +1,152 @@
+#include "Completion.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdexcept>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+
+PollingCompletion::PollingCompletion(int spins, std::chrono::microseconds max_sleep)
+    : _spins(spins), _max_sleep(max_sleep)
+{
+}
+
+bool PollingCompletion::Wait(const Condition &done, std::chrono::microseconds timeout)
+{
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    for (int i = 0; i < _spins; i++)
+    {
+        if (done())
+            return true;
+    }
+
+    std::chrono::microseconds sleep{0};
+    while (!done())
+    {
+        if (std::chrono::steady_clock::now() >= deadline)
+            return false;
+
+        if (sleep.count() == 0)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(sleep);
+        sleep = std::clamp(sleep * 2, std::chrono::microseconds(1), _max_sleep);
+    }
+
+    return true;
+}
+
+IrqCompletion::IrqCompletion(const std::string &device)
+{
+    fd = open(device.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error("Failed to open " + device + ": " + strerror(errno));
+    owns_fd = true;
+}
+
+IrqCompletion::IrqCompletion(int fd, bool uio) : fd(fd), is_uio(uio)
+{
+}
+
+IrqCompletion::~IrqCompletion()
+{
+    if (owns_fd && fd >= 0)
+        close(fd);
+}
+
+/**
+ * @brief Re-enable the interrupt line, uio_pdrv_genirq masks it on every
+ *   interrupt until userspace writes 1
+ */
+inline bool IrqCompletion::unmask()
+{
+    if (!is_uio)
+        return true;
+
+    uint32_t enable = 1;
+    return write(fd, &enable, sizeof(enable)) == (ssize_t)sizeof(enable);
+}
+
+/**
+ * @brief Read the pending interrupt count so the fd stops polling readable
+ */
+inline void IrqCompletion::consume()
+{
+    if (is_uio)
+    {
+        uint32_t count = 0; // UIO only accepts reads of exactly 4 bytes
+        if (read(fd, &count, sizeof(count)) == (ssize_t)sizeof(count))
+            irq_count = count;
+    }
+    else
+    {
+        uint64_t count = 0; // eventfd needs at least 8 bytes
+        if (read(fd, &count, sizeof(count)) == (ssize_t)sizeof(count))
+            irq_count += count;
+    }
+}
+
+bool IrqCompletion::Wait(const Condition &done, std::chrono::microseconds timeout)
+{
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    while (true)
+    {
+        // Unmask before checking, an interrupt after the check then wakes poll()
+        bool armed = unmask();
+        if (done())
+            return true;
+
+        auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0)
+            return false;
+
+        pollfd pfd{fd, POLLIN, 0};
+        int ready = armed ? poll(&pfd, 1, (int)left.count()) : -1;
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready < 0 || (ready > 0 && (pfd.revents & (POLLERR | POLLNVAL))))
+        {
+            // The device went away, finish by polling the register
+            auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now());
+            return PollingCompletion().Wait(done, std::max(remaining, std::chrono::microseconds(0)));
+        }
+        if (ready > 0)
+        {
+            wakeups++;
+            consume();
+        }
+    }
+}
+
+uint64_t IrqCompletion::GetInterruptCount() const
+{
+    return irq_count;
+}
+
+uint64_t IrqCompletion::GetWakeupCount() const
+{
+    return wakeups;
+}
+
+std::unique_ptr<Completion> MakeCompletion(const std::string &device)
+{
+    if (!device.empty())
+    {
+        try
+        {
+            return std::make_unique<IrqCompletion>(device);
+        }
+        catch (const std::runtime_error &e)
+        {
+            // A misconfigured IRQ device still works, only slower, say why
+            fprintf(stderr, "%s, waiting by polling instead\n", e.what());
+        }
+    }
+    return std::make_unique<PollingCompletion>();
+}
@@ -0,0 +1,94 @@
+#ifndef AXIDMA_API_COMPLETION_H
+#define AXIDMA_API_COMPLETION_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+/**
+ * @class Waits for a DMA channel to finish. The caller passes the check that
+ *   reads the status register, the backend decides how to sleep between checks
+ */
+class Completion
+{
+public:
+    using Condition = std::function<bool()>;
+
+    /**
+     * @brief Wait until done() returns true
+     * @param[in] done    - checks the hardware, may acknowledge the interrupt
+     * @param[in] timeout - give up after this long
+     *
+     * @return true  - done() returned true
+     * @return false - timeout
+     */
+    virtual bool Wait(const Condition &done, std::chrono::microseconds timeout) = 0;
+
+    virtual ~Completion() = default;
+};
+
+/**
+ * @class Polls the status register. Spins first so short transfers complete
+ *   with no scheduling latency, then yields and sleeps for doubling intervals
+ *   up to max_sleep so long waits don't burn a core
+ */
+class PollingCompletion : public Completion
+{
+public:
+    explicit PollingCompletion(int spins = 1000,
+                               std::chrono::microseconds max_sleep = std::chrono::microseconds(100));
+
+    bool Wait(const Condition &done, std::chrono::microseconds timeout) override;
+
+private:
+    int _spins;
+    std::chrono::microseconds _max_sleep;
+};
+
+/**
+ * @class Sleeps in poll() on an interrupt file descriptor until the channel
+ *   raises IOC or an error. With a UIO device (/dev/uioN bound to the DMA
+ *   interrupt by uio_pdrv_genirq) the interrupt is unmasked by writing 1 and
+ *   the interrupt count is read as 4 bytes. Any other fd (i.e. an eventfd in
+ *   tests) is only read, as 8 bytes.
+ * @note done() is checked again after every unmask, so an interrupt raised
+ *   before the wait started is never missed
+ */
+class IrqCompletion : public Completion
+{
+public:
+    explicit IrqCompletion(const std::string &device);
+    IrqCompletion(int fd, bool uio);
+
+    IrqCompletion(const IrqCompletion &) = delete;
+    IrqCompletion &operator=(const IrqCompletion &) = delete;
+
+    bool Wait(const Condition &done, std::chrono::microseconds timeout) override;
+
+    uint64_t GetInterruptCount() const;
+    uint64_t GetWakeupCount() const;
+
+    ~IrqCompletion() override;
+
+private:
+    int fd{-1};
+    bool owns_fd{false};
+    bool is_uio{true};
+    uint64_t irq_count{0}; // Interrupt count reported by the device
+    uint64_t wakeups{0};   // Times poll() returned with the fd readable
+
+    bool unmask();
+    void consume();
+};
+
+/**
+ * @brief Completion for one DMA channel
+ * @param[in] device - UIO device of the channel interrupt, empty for polling
+ *
+ * @return IrqCompletion if the device opens, otherwise PollingCompletion
+ */
+std::unique_ptr<Completion> MakeCompletion(const std::string &device);
+
+#endif // AXIDMA_API_COMPLETION_H
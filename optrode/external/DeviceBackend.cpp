@@ -0,0 +1,154 @@
+#include "DeviceBackend.h"
+
+#include <cstdlib>
+#include <fcntl.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "SimulatedBackend.h"
+
+namespace
+{
+    /**
+     * @class Registers mapped from /dev/mem, every access goes to the bus
+     */
+    class MappedRegisters : public RegisterBlock
+    {
+    public:
+        MappedRegisters(volatile uint32_t *regs, size_t size) : regs(regs), size(size) {}
+
+        uint32_t Read(uint32_t offset) override
+        {
+            return regs[offset >> 2];
+        }
+
+        void Write(uint32_t offset, uint32_t value) override
+        {
+            regs[offset >> 2] = value;
+        }
+
+        ~MappedRegisters() override
+        {
+            munmap(const_cast<uint32_t *>(regs), size);
+        }
+
+    private:
+        volatile uint32_t *regs;
+        size_t size;
+    };
+
+    std::mutex backend_mute;
+    std::unique_ptr<DeviceBackend> backend;
+}
+
+int DeviceBackend::GetIrqFd(uint32_t, bool)
+{
+    return -1;
+}
+
+DevMemBackend::~DevMemBackend()
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+int DevMemBackend::getFd()
+{
+    std::lock_guard<std::mutex> lock(fd_mute);
+    if (fd < 0)
+        fd = open("/dev/mem", O_RDWR | O_SYNC);
+    return fd;
+}
+
+std::unique_ptr<RegisterBlock> DevMemBackend::MapRegisters(uint32_t base_addr, size_t size)
+{
+    if (getFd() < 0)
+        return nullptr;
+
+    void *regs = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, base_addr);
+    if (regs == MAP_FAILED)
+        return nullptr;
+
+    return std::make_unique<MappedRegisters>(static_cast<volatile uint32_t *>(regs), size);
+}
+
+/**
+ * @note mmap needs page aligned offsets, so an unaligned address maps from the
+ *   page below it
+ */
+void *DevMemBackend::MapMemory(uint32_t phys_addr, size_t size)
+{
+    if (getFd() < 0)
+        return nullptr;
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t delta = phys_addr % page;
+    auto *mem = (uint8_t *)mmap(nullptr, size + delta, PROT_READ | PROT_WRITE,
+                                MAP_SHARED, fd, phys_addr - delta);
+    if (mem == MAP_FAILED)
+        return nullptr;
+
+    return mem + delta;
+}
+
+void DevMemBackend::UnmapMemory(void *addr, size_t size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t delta = (std::uintptr_t)addr % page;
+    munmap((uint8_t *)addr - delta, size + delta);
+}
+
+std::unique_ptr<DeviceBackend> MakeDeviceBackend(const std::string &spec)
+{
+    std::istringstream fields(spec);
+    std::string name;
+    std::getline(fields, name, ',');
+
+    if (name == "devmem" || name.empty())
+        return std::make_unique<DevMemBackend>();
+    if (name != "sim")
+        throw std::invalid_argument("Unknown device backend: " + name);
+
+    SimulatedBackend::Config config;
+    std::string field;
+    while (std::getline(fields, field, ','))
+    {
+        auto eq = field.find('=');
+        if (eq == std::string::npos)
+            throw std::invalid_argument("Simulated device setting needs a value: " + field);
+
+        std::string key = field.substr(0, eq);
+        double value = std::stod(field.substr(eq + 1));
+        if (key == "latency_us")
+            config.latency = std::chrono::microseconds((int64_t)value);
+        else if (key == "bandwidth_MBps")
+            config.bytes_per_second = value * 1e6;
+        else if (key == "fifo_kb")
+            config.fifo_bytes = (size_t)(value * 1024);
+        else if (key == "sg")
+            config.scatter_gather = value != 0;
+        else
+            throw std::invalid_argument("Unknown simulated device setting: " + key);
+    }
+
+    return std::make_unique<SimulatedBackend>(config);
+}
+
+DeviceBackend &GetDeviceBackend()
+{
+    std::lock_guard<std::mutex> lock(backend_mute);
+    if (!backend)
+    {
+        const char *spec = std::getenv("AXIDMA_DEVICE");
+        backend = MakeDeviceBackend(spec != nullptr ? spec : "devmem");
+    }
+    return *backend;
+}
+
+void SetDeviceBackend(std::unique_ptr<DeviceBackend> new_backend)
+{
+    std::lock_guard<std::mutex> lock(backend_mute);
+    backend = std::move(new_backend);
+}
@@ -0,0 +1,107 @@
+#ifndef AXIDMA_API_DEVICEBACKEND_H
+#define AXIDMA_API_DEVICEBACKEND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * @class Register block of one AXI DMA core
+ */
+class RegisterBlock
+{
+public:
+    virtual uint32_t Read(uint32_t offset) = 0;
+    virtual void Write(uint32_t offset, uint32_t value) = 0;
+
+    virtual ~RegisterBlock() = default;
+};
+
+/**
+ * @class Where DMA registers and physical memory (buffers, descriptors) come
+ *   from. The hardware uses /dev/mem, tests and benchmarks can swap in a
+ *   simulated device (see SimulatedBackend)
+ */
+class DeviceBackend
+{
+public:
+    /**
+     * @brief Map the register block of an AXI DMA core
+     * @param[in] base_addr - physical base address of the core
+     * @param[in] size      - size of the register block (in bytes)
+     *
+     * @return registers - the block, valid while the backend lives
+     * @return nullptr   - can't map the registers
+     */
+    virtual std::unique_ptr<RegisterBlock> MapRegisters(uint32_t base_addr, size_t size) = 0;
+
+    /**
+     * @brief Map physical memory, the same address mapped twice aliases
+     * @param[in] phys_addr - physical address
+     * @param[in] size      - size of the mapping (in bytes)
+     *
+     * @return memory  - virtual address of phys_addr
+     * @return nullptr - can't map the memory
+     */
+    virtual void *MapMemory(uint32_t phys_addr, size_t size) = 0;
+    virtual void UnmapMemory(void *addr, size_t size) = 0;
+
+    /**
+     * @brief File descriptor signalled (eventfd style) on a channel's interrupts
+     * @param[in] base_addr - physical base address of the core
+     * @param[in] way       - the way of transfer: true - RX; false - TX
+     *
+     * @return fd - see IrqCompletion
+     * @return -1 - none, use the UIO device or polling
+     */
+    virtual int GetIrqFd(uint32_t base_addr, bool way);
+
+    virtual ~DeviceBackend() = default;
+};
+
+/**
+ * @class Registers and memory through /dev/mem, opened on first use
+ */
+class DevMemBackend : public DeviceBackend
+{
+public:
+    std::unique_ptr<RegisterBlock> MapRegisters(uint32_t base_addr, size_t size) override;
+    void *MapMemory(uint32_t phys_addr, size_t size) override;
+    void UnmapMemory(void *addr, size_t size) override;
+
+    ~DevMemBackend() override;
+
+private:
+    std::mutex fd_mute;
+    int fd{-1};
+
+    int getFd();
+};
+
+/**
+ * @brief Create a backend from its description
+ * @param[in] spec - "devmem", or "sim" with optional comma separated settings
+ *   i.e. "sim,latency_us=20,bandwidth_MBps=100,fifo_kb=64,sg=1"
+ *   with the stream bandwidth in megabytes per second
+ *
+ * @return backend
+ * @note Throws std::invalid_argument for an unknown backend or setting
+ */
+std::unique_ptr<DeviceBackend> MakeDeviceBackend(const std::string &spec);
+
+/**
+ * @brief Backend used by AxiDMA, AxiDmaDescriptors and AxiStreamDma. Until one
+ *   is set it is made from the AXIDMA_DEVICE environment variable, or /dev/mem
+ */
+DeviceBackend &GetDeviceBackend();
+
+/**
+ * @brief Replace the backend
+ * @note Only before any DMA object is created, they keep mappings from the
+ *   backend they started with
+ */
+void SetDeviceBackend(std::unique_ptr<DeviceBackend> backend);
+
+#endif // AXIDMA_API_DEVICEBACKEND_H
@@ -0,0 +1,482 @@
+#include "SimulatedBackend.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    // Registers relative to the channel, S2MM is 0x30 above MM2S (PG021)
+    constexpr uint32_t DMACR = 0x00;
+    constexpr uint32_t DMASR = 0x04;
+    constexpr uint32_t CURDESC = 0x08;
+    constexpr uint32_t TAILDESC = 0x10;
+    constexpr uint32_t ADDRESS = 0x18;
+    constexpr uint32_t LENGTH = 0x28;
+    constexpr uint32_t S2MM_OFFSET = 0x30;
+    constexpr uint32_t REGISTERS_SIZE = 0x60;
+
+    constexpr uint32_t DMACR_RUN = 0x00000001;
+    constexpr uint32_t DMACR_RESET = 0x00000004;
+    constexpr uint32_t DMACR_RESET_VALUE = 0x00010002; // threshold 1, reserved bit 1
+    constexpr uint32_t DMASR_HALTED = 0x00000001;
+    constexpr uint32_t DMASR_IDLE = 0x00000002;
+    constexpr uint32_t DMASR_SG = 0x00000008;
+    constexpr uint32_t DMASR_DMADECERR = 0x00000040;
+    constexpr uint32_t DMASR_SGDECERR = 0x00000400;
+    constexpr uint32_t DMASR_IOC = 0x00001000;
+    constexpr uint32_t DMASR_ERR = 0x00004000;
+    constexpr uint32_t DMA_IRQ_MASK = 0x00007000;
+    constexpr uint32_t LENGTH_MASK = 0x03FFFFFF;
+
+    // Descriptor words
+    constexpr uint32_t BD_NEXTDESC = 0x00 / 4;
+    constexpr uint32_t BD_BUFFER = 0x08 / 4;
+    constexpr uint32_t BD_CONTROL = 0x18 / 4;
+    constexpr uint32_t BD_STATUS = 0x1C / 4;
+    constexpr uint32_t BD_SIZE = 0x34;
+    constexpr uint32_t BD_COMPLETE = 0x80000000;
+    constexpr uint32_t BD_SOF = 0x08000000;
+    constexpr uint32_t BD_EOF = 0x04000000;
+
+    /**
+     * @class Stream data between the channels, one entry per packet
+     */
+    struct Packet
+    {
+        std::vector<uint8_t> data;
+        size_t offset{0};
+        bool closed{false}; // TLAST seen
+    };
+}
+
+/**
+ * @class One simulated AXI DMA core, its registers and the device thread that
+ *   moves the data
+ */
+class SimulatedBackend::Core
+{
+public:
+    explicit Core(SimulatedBackend &backend) : backend(backend)
+    {
+        mm2s.base = 0;
+        s2mm.base = S2MM_OFFSET;
+        mm2s.irq_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        s2mm.irq_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (mm2s.irq_fd < 0 || s2mm.irq_fd < 0)
+            throw std::runtime_error("Can't create simulated DMA interrupts");
+
+        reset();
+        device = std::thread(&Core::run, this);
+    }
+
+    ~Core()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mute);
+            stopping = true;
+        }
+        wake.notify_all();
+        device.join();
+
+        close(mm2s.irq_fd);
+        close(s2mm.irq_fd);
+    }
+
+    uint32_t Read(uint32_t offset)
+    {
+        std::lock_guard<std::mutex> lock(mute);
+        return offset < REGISTERS_SIZE ? regs[offset >> 2] : 0;
+    }
+
+    void Write(uint32_t offset, uint32_t value)
+    {
+        std::lock_guard<std::mutex> lock(mute);
+        if (offset >= REGISTERS_SIZE)
+            return;
+
+        Channel &ch = offset < S2MM_OFFSET ? mm2s : s2mm;
+        switch (offset - ch.base)
+        {
+        case DMACR:
+            if (value & DMACR_RESET)
+            {
+                reset(); // resets both channels, the bit clears at once
+                break;
+            }
+            reg(ch, DMACR) = value;
+            if ((value & DMACR_RUN) && (reg(ch, DMASR) & DMASR_HALTED))
+            {
+                reg(ch, DMASR) &= ~DMASR_HALTED;
+                ch.next_desc = reg(ch, CURDESC);
+            }
+            else if (!(value & DMACR_RUN))
+            {
+                reg(ch, DMASR) |= DMASR_HALTED;
+                ch.pending = false;
+            }
+            break;
+        case DMASR:
+            reg(ch, DMASR) &= ~(value & DMA_IRQ_MASK); // write one to clear
+            break;
+        case TAILDESC:
+            reg(ch, TAILDESC) = value;
+            // Fetching goes on from the descriptor after the last one completed
+            // until the tail completes, a full lap if the tail is rewritten
+            if (backend._config.scatter_gather && running(ch))
+            {
+                ch.pending = true;
+                reg(ch, DMASR) &= ~DMASR_IDLE;
+            }
+            break;
+        case LENGTH:
+            reg(ch, LENGTH) = value;
+            if (!backend._config.scatter_gather && running(ch) && (value & LENGTH_MASK) != 0)
+            {
+                ch.pending = true;
+                ch.filled = 0;
+                reg(ch, DMASR) &= ~DMASR_IDLE;
+            }
+            break;
+        default:
+            regs[offset >> 2] = value;
+            break;
+        }
+        wake.notify_all();
+    }
+
+    int GetIrqFd(bool way) const
+    {
+        return way ? s2mm.irq_fd : mm2s.irq_fd;
+    }
+
+private:
+    struct Channel
+    {
+        uint32_t base{0};
+        int irq_fd{-1};
+        bool pending{false};      // A transfer or descriptors are waiting
+        uint32_t filled{0};       // S2MM bytes written to the current buffer
+        bool in_packet{false};    // S2MM buffer started mid packet
+        bool buffer_sof{false};   // S2MM current buffer holds a packet start
+        uint32_t next_desc{0};    // SG descriptor processed next
+        uint32_t done_desc{0};    // SG descriptor completed last
+        std::chrono::steady_clock::time_point busy_until{};
+    };
+
+    SimulatedBackend &backend;
+    std::mutex mute;
+    std::condition_variable wake;
+    uint32_t regs[REGISTERS_SIZE / 4]{};
+    Channel mm2s;
+    Channel s2mm;
+    std::deque<Packet> stream;
+    size_t stream_bytes{0};
+    uint64_t generation{0}; // Bumped by reset, drops transfers in flight
+    bool stopping{false};
+    std::thread device;
+
+    uint32_t &reg(Channel &ch, uint32_t offset)
+    {
+        return regs[(ch.base + offset) >> 2];
+    }
+
+    bool running(Channel &ch)
+    {
+        return (reg(ch, DMACR) & DMACR_RUN) && !(reg(ch, DMASR) & DMASR_HALTED);
+    }
+
+    void reset()
+    {
+        std::fill(std::begin(regs), std::end(regs), 0);
+        for (Channel *ch : {&mm2s, &s2mm})
+        {
+            reg(*ch, DMACR) = DMACR_RESET_VALUE;
+            reg(*ch, DMASR) = DMASR_HALTED | (backend._config.scatter_gather ? DMASR_SG : 0);
+            ch->pending = false;
+            ch->filled = 0;
+            ch->in_packet = false;
+            ch->buffer_sof = false;
+            ch->next_desc = 0;
+            ch->done_desc = 0;
+        }
+        stream.clear();
+        stream_bytes = 0;
+        generation++;
+    }
+
+    void raise(Channel &ch, uint32_t irq)
+    {
+        reg(ch, DMASR) |= irq;
+        if (reg(ch, DMACR) & irq & DMA_IRQ_MASK)
+        {
+            uint64_t one = 1;
+            if (::write(ch.irq_fd, &one, sizeof(one)) != (ssize_t)sizeof(one))
+                return; // counter saturated, the fd is readable anyway
+        }
+    }
+
+    void fail(Channel &ch, uint32_t error)
+    {
+        ch.pending = false;
+        reg(ch, DMASR) |= error | DMASR_HALTED;
+        raise(ch, DMASR_ERR);
+    }
+
+    uint32_t *descriptor(uint32_t addr)
+    {
+        return (uint32_t *)backend.MapMemory(addr, BD_SIZE);
+    }
+
+    /**
+     * @brief Finish the channel's current descriptor, idle once it was the tail
+     */
+    void completeDescriptor(Channel &ch, uint32_t *bd, uint32_t status)
+    {
+        bd[BD_STATUS] = status;
+        ch.done_desc = ch.next_desc;
+        reg(ch, CURDESC) = ch.next_desc;
+        ch.next_desc = bd[BD_NEXTDESC];
+        if (ch.done_desc == reg(ch, TAILDESC))
+        {
+            ch.pending = false;
+            reg(ch, DMASR) |= DMASR_IDLE;
+        }
+    }
+
+    /**
+     * @brief Read one MM2S transfer or descriptor into the stream, taking as
+     *   long as latency and bandwidth allow
+     */
+    bool stepMm2s(std::unique_lock<std::mutex> &lock)
+    {
+        const Config &config = backend._config;
+        if (!mm2s.pending || !running(mm2s))
+            return false;
+
+        uint32_t *bd = nullptr;
+        uint32_t src, length;
+        bool eof = true; // direct mode always ends the packet
+        if (config.scatter_gather)
+        {
+            bd = descriptor(mm2s.next_desc);
+            if (bd == nullptr)
+            {
+                fail(mm2s, DMASR_SGDECERR);
+                return true;
+            }
+            src = bd[BD_BUFFER];
+            length = bd[BD_CONTROL] & LENGTH_MASK;
+            eof = (bd[BD_CONTROL] & BD_EOF) != 0;
+        }
+        else
+        {
+            src = reg(mm2s, ADDRESS);
+            length = reg(mm2s, LENGTH) & LENGTH_MASK;
+        }
+
+        // Backpressure, the stream only takes what S2MM has drained
+        if (stream_bytes > 0 && stream_bytes + length > config.fifo_bytes)
+            return false;
+
+        auto *data = (const uint8_t *)backend.MapMemory(src, length);
+        if (data == nullptr)
+        {
+            fail(mm2s, DMASR_DMADECERR);
+            return true;
+        }
+
+        auto start = std::max(std::chrono::steady_clock::now(), mm2s.busy_until);
+        auto duration = std::chrono::duration<double>(config.bytes_per_second > 0 ? length / config.bytes_per_second : 0.0);
+        mm2s.busy_until = start + config.latency + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+
+        uint64_t started = generation;
+        auto finish = mm2s.busy_until;
+        lock.unlock();
+        std::this_thread::sleep_until(finish);
+        lock.lock();
+        if (started != generation || !running(mm2s))
+            return true;
+
+        if (stream.empty() || stream.back().closed)
+            stream.emplace_back();
+        stream.back().data.insert(stream.back().data.end(), data, data + length);
+        stream.back().closed = eof;
+        stream_bytes += length;
+
+        if (config.scatter_gather)
+            completeDescriptor(mm2s, bd, BD_COMPLETE | length);
+        else
+        {
+            mm2s.pending = false;
+            reg(mm2s, DMASR) |= DMASR_IDLE;
+        }
+        if (eof)
+            raise(mm2s, DMASR_IOC);
+        return true;
+    }
+
+    /**
+     * @brief Write stream data into the armed S2MM buffer or descriptor,
+     *   completing it when it's full or the packet ends
+     */
+    bool stepS2mm()
+    {
+        const Config &config = backend._config;
+        if (!s2mm.pending || !running(s2mm) || stream.empty())
+            return false;
+
+        Packet &packet = stream.front();
+        size_t available = packet.data.size() - packet.offset;
+        if (available == 0 && !packet.closed)
+            return false;
+
+        uint32_t *bd = nullptr;
+        uint32_t dst, capacity;
+        if (config.scatter_gather)
+        {
+            bd = descriptor(s2mm.next_desc);
+            if (bd == nullptr)
+            {
+                fail(s2mm, DMASR_SGDECERR);
+                return true;
+            }
+            dst = bd[BD_BUFFER];
+            capacity = bd[BD_CONTROL] & LENGTH_MASK;
+        }
+        else
+        {
+            dst = reg(s2mm, ADDRESS);
+            capacity = reg(s2mm, LENGTH) & LENGTH_MASK;
+        }
+
+        size_t count = std::min<size_t>(capacity - s2mm.filled, available);
+        auto *out = (uint8_t *)backend.MapMemory(dst + s2mm.filled, count);
+        if (out == nullptr)
+        {
+            fail(s2mm, DMASR_DMADECERR);
+            return true;
+        }
+
+        if (s2mm.filled == 0)
+            s2mm.buffer_sof = !s2mm.in_packet;
+        std::memcpy(out, packet.data.data() + packet.offset, count);
+        packet.offset += count;
+        stream_bytes -= count;
+        s2mm.filled += count;
+        s2mm.in_packet = true;
+
+        bool eof = packet.closed && packet.offset == packet.data.size();
+        if (eof)
+        {
+            stream.pop_front();
+            s2mm.in_packet = false;
+        }
+        if (s2mm.filled < capacity && !eof)
+            return true;
+
+        if (config.scatter_gather)
+            completeDescriptor(s2mm, bd, BD_COMPLETE | s2mm.filled | (s2mm.buffer_sof ? BD_SOF : 0) | (eof ? BD_EOF : 0));
+        else
+        {
+            reg(s2mm, LENGTH) = s2mm.filled; // bytes actually received
+            s2mm.pending = false;
+            reg(s2mm, DMASR) |= DMASR_IDLE;
+        }
+        s2mm.filled = 0;
+        raise(s2mm, DMASR_IOC);
+        return true;
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mute);
+        while (!stopping)
+        {
+            bool moved = stepS2mm();
+            moved = stepMm2s(lock) || moved;
+            if (!moved)
+                wake.wait(lock);
+        }
+    }
+};
+
+SimulatedBackend::SimulatedBackend(Config config) : _config(config)
+{
+    if (_config.memory_size > SIZE_MAX)
+        throw std::invalid_argument("Simulated memory doesn't fit the address space");
+
+    // Sparse, pages are only allocated when the DMA code touches them
+    void *mem = mmap(nullptr, (size_t)_config.memory_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem == MAP_FAILED)
+        throw std::runtime_error("Can't map simulated DMA memory");
+    memory = (uint8_t *)mem;
+}
+
+SimulatedBackend::~SimulatedBackend()
+{
+    cores.clear(); // stop device threads before their memory goes
+    munmap(memory, (size_t)_config.memory_size);
+}
+
+SimulatedBackend::Core &SimulatedBackend::getCore(uint32_t base_addr)
+{
+    std::lock_guard<std::mutex> lock(cores_mute);
+    auto &core = cores[base_addr];
+    if (!core)
+        core = std::make_unique<Core>(*this);
+    return *core;
+}
+
+std::unique_ptr<RegisterBlock> SimulatedBackend::MapRegisters(uint32_t base_addr, size_t)
+{
+    class Registers : public RegisterBlock
+    {
+    public:
+        explicit Registers(Core &core) : core(core) {}
+
+        uint32_t Read(uint32_t offset) override
+        {
+            return core.Read(offset);
+        }
+
+        void Write(uint32_t offset, uint32_t value) override
+        {
+            core.Write(offset, value);
+        }
+
+    private:
+        Core &core;
+    };
+
+    return std::make_unique<Registers>(getCore(base_addr));
+}
+
+void *SimulatedBackend::MapMemory(uint32_t phys_addr, size_t size)
+{
+    if ((uint64_t)phys_addr + size > _config.memory_size)
+        return nullptr;
+    return memory + phys_addr;
+}
+
+void SimulatedBackend::UnmapMemory(void *, size_t)
+{
+}
+
+int SimulatedBackend::GetIrqFd(uint32_t base_addr, bool way)
+{
+    return getCore(base_addr).GetIrqFd(way);
+}
+
+const SimulatedBackend::Config &SimulatedBackend::GetConfig() const
+{
+    return _config;
+}
@@ -0,0 +1,71 @@
+#ifndef AXIDMA_API_SIMULATEDBACKEND_H
+#define AXIDMA_API_SIMULATEDBACKEND_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "DeviceBackend.h"
+
+/**
+ * @class Software model of AXI DMA cores with MM2S looped back into S2MM, so
+ *   the DMA code runs on a normal Linux box.
+ *
+ *   Each core mapped through MapRegisters() gets its own register file and a
+ *   device thread. Writing the length registers (direct mode) or TAILDESC
+ *   (scatter gather) starts a transfer; MM2S data goes through a stream FIFO
+ *   into the buffers armed on S2MM, packets end where MM2S ended them (TLAST).
+ *   Status bits (halted, idle, IOC, errors, length/descriptor status) follow
+ *   PG021, and enabled interrupts are signalled on an eventfd per channel
+ *   (see GetIrqFd()).
+ *
+ *   Physical memory is a sparse anonymous mapping, so any address the real
+ *   design uses can be mapped and mappings of the same address alias.
+ * @note Simplifications: IOC is raised for every completed S2MM transfer or
+ *   descriptor and every MM2S packet, interrupt threshold and delay are
+ *   ignored, and an S2MM buffer shorter than the packet completes full
+ *   instead of raising an internal error.
+ */
+class SimulatedBackend : public DeviceBackend
+{
+public:
+    struct Config
+    {
+        std::chrono::microseconds latency{10};                // Setup time of every MM2S transfer
+        double bytes_per_second{400e6};                       // Stream bandwidth, 0 for unlimited
+        size_t fifo_bytes{65536};                             // Stream buffering between MM2S and S2MM
+        bool scatter_gather{false};                           // Core built with the SG engine
+        uint64_t memory_size{sizeof(void *) >= 8 ? 1ull << 32 : 1ull << 30}; // Simulated physical memory
+    };
+
+    explicit SimulatedBackend(Config config);
+    SimulatedBackend() : SimulatedBackend(Config{}) {}
+
+    SimulatedBackend(const SimulatedBackend &) = delete;
+    SimulatedBackend &operator=(const SimulatedBackend &) = delete;
+
+    std::unique_ptr<RegisterBlock> MapRegisters(uint32_t base_addr, size_t size) override;
+    void *MapMemory(uint32_t phys_addr, size_t size) override;
+    void UnmapMemory(void *addr, size_t size) override;
+    int GetIrqFd(uint32_t base_addr, bool way) override;
+
+    const Config &GetConfig() const;
+
+    ~SimulatedBackend() override;
+
+private:
+    class Core;
+
+    Config _config;
+    uint8_t *memory{nullptr};
+
+    std::mutex cores_mute;
+    std::map<uint32_t, std::unique_ptr<Core>> cores;
+
+    Core &getCore(uint32_t base_addr);
+};
+
+#endif // AXIDMA_API_SIMULATEDBACKEND_H
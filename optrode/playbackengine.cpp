@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <boost/log/trivial.hpp>
+
+#include "playbackengine.h"
+
+PlaybackEngine::PlaybackEngine(AxiStreamDma &dma, std::size_t depth) : dma(dma), depthSamples(depth * dma.transferLength() / sizeof(int32_t))
+{
+    if (depth < 1 || depth > MAX_PLAYBACK_DEPTH)
+        throw std::invalid_argument("PlaybackEngine depth must be between 1 and " + std::to_string(MAX_PLAYBACK_DEPTH) + " blocks");
+}
+
+PlaybackEngine::~PlaybackEngine()
+{
+    stop();
+}
+
+void PlaybackEngine::start(std::span<const int32_t> stimulus)
+{
+    if (running.exchange(true))
+        return;
+
+    this->stimulus = stimulus;
+    finished = stimulus.empty();
+    worker = std::thread(&PlaybackEngine::play, this);
+    BOOST_LOG_TRIVIAL(debug) << "playback engine started " << depthSamples << " samples deep on " << stimulus.size() << " samples";
+}
+
+void PlaybackEngine::stop()
+{
+    running = false;
+    if (worker.joinable())
+        worker.join();
+}
+
+void PlaybackEngine::acknowledge(std::size_t samples)
+{
+    uint64_t received = receivedCount.fetch_add(samples, std::memory_order_release) + samples;
+
+    // Every block whose last sample has come back has made the round trip
+    auto now = std::chrono::steady_clock::now();
+    while (haveOldest || inFlight.pop(oldest))
+    {
+        haveOldest = true;
+        if (oldest.endSample > received)
+            break;
+        haveOldest = false;
+
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(now - oldest.time).count();
+        lastLatencyUs.store(latency, std::memory_order_relaxed);
+        if (latency > maxLatencyUs.load(std::memory_order_relaxed))
+            maxLatencyUs.store(latency, std::memory_order_relaxed);
+    }
+}
+
+bool PlaybackEngine::done() const
+{
+    return finished.load(std::memory_order_acquire);
+}
+
+uint64_t PlaybackEngine::pending() const
+{
+    uint64_t received = receivedCount.load(std::memory_order_acquire);
+    uint64_t sent = sentCount.load(std::memory_order_acquire);
+    return sent > received ? sent - received : 0;
+}
+
+PlaybackMetrics PlaybackEngine::metrics() const
+{
+    return {
+        sentCount.load(std::memory_order_relaxed),
+        receivedCount.load(std::memory_order_relaxed),
+        maxInFlight.load(std::memory_order_relaxed),
+        stallCount.load(std::memory_order_relaxed),
+        std::chrono::microseconds(lastLatencyUs.load(std::memory_order_relaxed)),
+        std::chrono::microseconds(maxLatencyUs.load(std::memory_order_relaxed)),
+    };
+}
+
+void PlaybackEngine::play()
+{
+    std::size_t blockSamples = dma.transferLength() / sizeof(int32_t);
+    uint64_t position = 0;
+    bool stalled = false;
+
+    while (running.load(std::memory_order_relaxed) && position < stimulus.size())
+    {
+        if (dma.status == Status::ERROR)
+        {
+            BOOST_LOG_TRIVIAL(error) << "playback engine stopped on a DMA error";
+            break;
+        }
+
+        // Wait for the consumer to take back enough of the stream for a block
+        if (pending() + blockSamples > depthSamples || inFlight.size() == inFlight.capacity())
+        {
+            if (!stalled)
+                stallCount.fetch_add(1, std::memory_order_relaxed);
+            stalled = true;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
+        }
+        stalled = false;
+
+        std::size_t sent = dma.sendData(stimulus.subspan(position, std::min<std::size_t>(blockSamples, stimulus.size() - position)));
+        if (sent == 0)
+            continue;
+
+        position += sent;
+        inFlight.push({position, std::chrono::steady_clock::now()});
+        sentCount.store(position, std::memory_order_release);
+
+        std::size_t outstanding = pending();
+        if (outstanding > maxInFlight.load(std::memory_order_relaxed))
+            maxInFlight.store(outstanding, std::memory_order_relaxed);
+    }
+
+    finished.store(position >= stimulus.size(), std::memory_order_release);
+}
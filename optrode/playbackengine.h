@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <thread>
+
+#include "AxiStreamDma.h"
+#include "spscQueue.h"
+
+constexpr std::size_t MAX_PLAYBACK_DEPTH = 64;
+
+struct PlaybackMetrics
+{
+    uint64_t sentSamples;
+    uint64_t receivedSamples;
+    std::size_t maxInFlight;               // samples sent and not yet received
+    uint64_t creditStalls;                 // times playback waited on the consumer
+    std::chrono::microseconds lastLatency; // send of a block to its return
+    std::chrono::microseconds maxLatency;
+};
+
+// Streams a stimulus through MM2S on a playback thread while a CaptureEngine
+// drains S2MM, so both directions of the loopback run at once. Playback runs
+// at most depth blocks ahead of what the consumer has received, which bounds
+// the round trip latency and keeps the FPGA FIFOs from filling.
+//
+// The consumer reports each received block with acknowledge(), which returns
+// credit and matches the samples against the block they were sent in to
+// measure the round trip. start(), stop() and acknowledge() must be called
+// from one consumer thread.
+class PlaybackEngine
+{
+    struct Sent
+    {
+        uint64_t endSample;
+        std::chrono::steady_clock::time_point time;
+    };
+
+    AxiStreamDma &dma;
+    std::size_t depthSamples;
+    std::span<const int32_t> stimulus;
+
+    SpscQueue<Sent, MAX_PLAYBACK_DEPTH> inFlight; // playback thread to consumer
+    Sent oldest{};
+    bool haveOldest = false;
+
+    std::atomic<bool> running = false;
+    std::atomic<bool> finished = false;
+    std::atomic<uint64_t> sentCount = 0;
+    std::atomic<uint64_t> receivedCount = 0;
+    std::atomic<std::size_t> maxInFlight = 0;
+    std::atomic<uint64_t> stallCount = 0;
+    std::atomic<int64_t> lastLatencyUs = 0;
+    std::atomic<int64_t> maxLatencyUs = 0;
+    std::thread worker;
+
+    void play();
+
+public:
+    // depth in transfer length blocks
+    PlaybackEngine(AxiStreamDma &dma, std::size_t depth);
+    ~PlaybackEngine();
+
+    PlaybackEngine(const PlaybackEngine &) = delete;
+    PlaybackEngine &operator=(const PlaybackEngine &) = delete;
+
+    // stimulus must stay valid until done() or stop()
+    void start(std::span<const int32_t> stimulus);
+    void stop();
+
+    // Samples the consumer has received back
+    void acknowledge(std::size_t samples);
+
+    // Every stimulus sample has been handed to the DMA
+    bool done() const;
+
+    // Sent and not yet acknowledged
+    uint64_t pending() const;
+
+    PlaybackMetrics metrics() const;
+};
@@ -0,0 +1,36 @@
+#include <bit>
+#include <stdexcept>
+#include <string>
+
+#include "samplepool.h"
+
+static std::size_t poolBlocks(std::size_t bytes, std::size_t blockSamples)
+{
+    std::size_t count = blockSamples > 0 ? bytes / (blockSamples * sizeof(int32_t)) : 0;
+    if (count < 2 || count > MAX_POOL_BLOCKS)
+        throw std::invalid_argument("SamplePool needs between 2 and " + std::to_string(MAX_POOL_BLOCKS) + " blocks, " +
+                                    std::to_string(bytes) + " bytes makes " + std::to_string(count));
+    return count;
+}
+
+SamplePool::SamplePool(std::size_t bytes, std::size_t blockSamples)
+    : blockSamples(blockSamples), free(std::bit_ceil(poolBlocks(bytes, blockSamples)))
+{
+    std::size_t count = poolBlocks(bytes, blockSamples);
+
+    // Value initialised, so every page is faulted in here
+    arena.resize(count * blockSamples);
+    for (std::size_t index = 0; index < count; index++)
+        free.push(index);
+}
+
+bool SamplePool::acquire(std::size_t &index)
+{
+    return free.pop(index);
+}
+
+void SamplePool::release(std::size_t index)
+{
+    // Cannot fail, at most blocks() indices are ever out
+    free.push(index);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "spscQueue.h"
+
+constexpr std::size_t MAX_POOL_BLOCKS = 4096;
+
+// Fixed arena of equally sized sample blocks, allocated and touched once at
+// startup so capture never allocates or page faults in steady state. Blocks
+// are recycled through a lock-free free list: one thread acquires them and
+// another releases them once their samples have been used.
+class SamplePool
+{
+    std::size_t blockSamples;
+    std::vector<int32_t> arena;
+    SpscRing<std::size_t> free; // heap backed, sized to the block count
+
+public:
+    // As many blockSamples sized blocks as fit in bytes
+    SamplePool(std::size_t bytes, std::size_t blockSamples);
+
+    SamplePool(const SamplePool &) = delete;
+    SamplePool &operator=(const SamplePool &) = delete;
+
+    // Acquiring thread only, false when every block is out
+    bool acquire(std::size_t &index);
+
+    // Releasing thread only
+    void release(std::size_t index);
+
+    std::span<int32_t> block(std::size_t index)
+    {
+        return std::span<int32_t>(arena).subspan(index * blockSamples, blockSamples);
+    }
+
+    std::size_t blocks() const
+    {
+        return arena.size() / blockSamples;
+    }
+
+    std::size_t blockSize() const
+    {
+        return blockSamples;
+    }
+
+    // Approximate when called concurrently
+    std::size_t available() const
+    {
+        return free.size();
+    }
+};